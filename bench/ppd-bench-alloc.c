@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2026 The power-profiles-daemon authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+/* Preloaded into the daemon by ppd-bench, counts the calls to the
+ * allocator in the file named by PPD_BENCH_ALLOCATIONS, which the
+ * benchmark reads while the daemon runs. glibc only. */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static uint64_t *counter;
+
+__attribute__((constructor)) static void
+setup (void)
+{
+  const char *path = getenv ("PPD_BENCH_ALLOCATIONS");
+  void *map;
+  int fd;
+
+  if (path == NULL)
+    return;
+
+  fd = open (path, O_RDWR | O_CLOEXEC);
+  if (fd < 0)
+    return;
+  map = mmap (NULL, sizeof (*counter), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map != MAP_FAILED)
+    counter = map;
+
+  /* Only count the daemon, not the backend commands it spawns */
+  unsetenv ("PPD_BENCH_ALLOCATIONS");
+  unsetenv ("LD_PRELOAD");
+}
+
+static void
+count (void)
+{
+  if (counter)
+    __atomic_add_fetch (counter, 1, __ATOMIC_RELAXED);
+}
+
+void *
+malloc (size_t size)
+{
+  count ();
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+  count ();
+  return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+  count ();
+  return __libc_realloc (ptr, size);
+}
@@ -0,0 +1,459 @@
+/*
+ * Copyright (c) 2026 The power-profiles-daemon authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+/* Microbenchmarks for the helpers the daemon runs on every profile
+ * switch, for the bookkeeping of profile holds, and for the
+ * serialization of its D-Bus properties. Run with
+ * "meson test --benchmark", or directly:
+ *
+ *   ppd-microbench [--json] [--min-time=MS] [FILTER]
+ *
+ * The daemon is built into this executable so that its static
+ * functions can be measured without going through D-Bus. */
+
+#define main power_profiles_daemon_main
+#include "power-profiles-daemon.c"
+#undef main
+
+#include <string.h>
+#include <sys/socket.h>
+
+#define PPD_TYPE_DRIVER_BENCH (ppd_driver_bench_get_type ())
+G_DECLARE_FINAL_TYPE (PpdDriverBench, ppd_driver_bench, PPD, DRIVER_BENCH, PpdDriverPlatform)
+
+struct _PpdDriverBench
+{
+  PpdDriverPlatform  parent_instance;
+};
+
+G_DEFINE_TYPE (PpdDriverBench, ppd_driver_bench, PPD_TYPE_DRIVER_PLATFORM)
+
+static void
+ppd_driver_bench_class_init (PpdDriverBenchClass *klass)
+{
+}
+
+static void
+ppd_driver_bench_init (PpdDriverBench *self)
+{
+}
+
+typedef struct {
+  const char *name;
+  void (*func) (gpointer user_data);
+  gpointer user_data;
+} Benchmark;
+
+typedef struct {
+  PpdApp *data;
+  PropertiesMask mask;
+} PropsBench;
+
+typedef struct {
+  char *dir;
+  char *path;
+  GPtrArray *paths;
+} WriteBench;
+
+/* The client holding profiles in the hold benchmarks */
+#define BENCH_CLIENT ":1.bench"
+
+static gint64 min_time = 200 * G_TIME_SPAN_MILLISECOND;
+
+/* Optimisation barrier, so the compiler keeps the results */
+static volatile gsize sink;
+
+static ProfileHold *
+bench_hold_new (PpdProfile  profile,
+                const char *application_id,
+                const char *requester)
+{
+  ProfileHold *hold = g_new0 (ProfileHold, 1);
+
+  hold->profile = profile;
+  hold->reason = g_strdup ("Benchmarking");
+  hold->application_id = g_strdup (application_id);
+  hold->requester = g_strdup (requester);
+  hold->requester_iface = g_strdup (POWER_PROFILES_IFACE_NAME);
+
+  return hold;
+}
+
+static PpdApp *
+create_app (guint n_holds)
+{
+  PpdApp *data = g_new0 (PpdApp, 1);
+
+  data->settings = g_new0 (PpdSettings, 1);
+  data->stats = ppd_stats_ref (ppd_stats_get_default ());
+  data->metrics = ppd_metrics_new (data->stats);
+  data->clients = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) client_free);
+  data->peers = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+  data->actions = g_ptr_array_new_with_free_func (g_object_unref);
+  data->profile_holds = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                               NULL, (GDestroyNotify) profile_hold_free);
+  data->platform_driver = g_object_new (PPD_TYPE_DRIVER_BENCH,
+                                        "driver-name", "bench",
+                                        "profiles", PPD_PROFILE_ALL,
+                                        NULL);
+  data->active_profile = PPD_PROFILE_BALANCED;
+  data->selected_profile = PPD_PROFILE_BALANCED;
+
+  for (guint i = 0; i < n_holds; i++) {
+    g_autofree char *application_id = g_strdup_printf ("org.example.App%u", i % 100);
+    g_autofree char *requester = g_strdup_printf (":1.%u", i);
+    ProfileHold *hold;
+
+    hold = bench_hold_new ((i % 2) ? PPD_PROFILE_PERFORMANCE : PPD_PROFILE_POWER_SAVER,
+                           application_id, requester);
+    g_hash_table_insert (data->profile_holds, GUINT_TO_POINTER (++data->last_cookie), hold);
+    count_profile_hold (data, hold, 1);
+  }
+
+  return data;
+}
+
+static void
+free_app (PpdApp *data)
+{
+  g_clear_pointer (&data->clients, g_hash_table_unref);
+  g_clear_pointer (&data->peers, g_ptr_array_unref);
+  g_clear_pointer (&data->actions, g_ptr_array_unref);
+  g_clear_pointer (&data->profile_holds, g_hash_table_unref);
+  g_clear_object (&data->platform_driver);
+  g_clear_object (&data->connection);
+  g_clear_pointer (&data->metrics, ppd_metrics_unref);
+  g_clear_pointer (&data->stats, ppd_stats_unref);
+  g_clear_pointer (&data->settings, settings_free);
+  g_free (data);
+}
+
+static void
+connection_ready_cb (GObject      *source_object,
+                     GAsyncResult *res,
+                     gpointer      user_data)
+{
+  GDBusConnection **connection = user_data;
+  g_autoptr(GError) error = NULL;
+
+  *connection = g_dbus_connection_new_finish (res, &error);
+  if (*connection == NULL)
+    g_error ("Could not set up a D-Bus connection: %s", error->message);
+}
+
+/* A peer-to-peer connection, so that the signals sent when holds are
+ * released go somewhere. @server is the end that receives them. */
+static GDBusConnection *
+create_connection (GDBusConnection **server)
+{
+  g_autofree char *guid = g_dbus_generate_guid ();
+  GDBusConnection *client = NULL;
+  int fds[2];
+
+  if (socketpair (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+    g_error ("Could not create a socket pair: %s", g_strerror (errno));
+
+  for (guint i = 0; i < G_N_ELEMENTS (fds); i++) {
+    g_autoptr(GSocket) socket = NULL;
+    g_autoptr(GSocketConnection) stream = NULL;
+    g_autoptr(GError) error = NULL;
+
+    socket = g_socket_new_from_fd (fds[i], &error);
+    if (socket == NULL)
+      g_error ("Could not create a socket: %s", error->message);
+    stream = g_socket_connection_factory_create_connection (socket);
+    g_dbus_connection_new (G_IO_STREAM (stream), i == 0 ? guid : NULL,
+                           i == 0 ? G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_SERVER :
+                                    G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+                           NULL, NULL, connection_ready_cb, i == 0 ? (gpointer) server : &client);
+  }
+
+  /* Both ends authenticate at the same time */
+  while (*server == NULL || client == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  return client;
+}
+
+static void
+bench_utils_write (gpointer user_data)
+{
+  WriteBench *bench = user_data;
+
+  if (!ppd_utils_write (bench->path, "balance_performance", NULL))
+    g_error ("Could not write to %s", bench->path);
+}
+
+static void
+bench_utils_write_files (gpointer user_data)
+{
+  WriteBench *bench = user_data;
+
+  if (!ppd_utils_write_files (bench->paths, "balance_performance", NULL))
+    g_error ("Could not write to %s", bench->dir);
+}
+
+static void
+bench_match_cpu_vendor (gpointer user_data)
+{
+  /* No such vendor, so the whole file is scanned */
+  sink += ppd_utils_match_cpu_vendor ("BenchmarkVendor");
+}
+
+static void
+bench_profile_from_str (gpointer user_data)
+{
+  sink += ppd_profile_from_str ("power-saver");
+  sink += ppd_profile_from_str ("balanced");
+  sink += ppd_profile_from_str ("performance");
+}
+
+static void
+bench_profiles_variant (gpointer user_data)
+{
+  PpdApp *data = user_data;
+  g_autoptr(GVariant) variant = g_variant_ref_sink (get_profiles_variant (data));
+
+  sink += g_variant_n_children (variant);
+}
+
+static void
+bench_holds_variant (gpointer user_data)
+{
+  PpdApp *data = user_data;
+  g_autoptr(GVariant) variant = g_variant_ref_sink (get_profile_holds_variant (data));
+
+  sink += g_variant_n_children (variant);
+}
+
+static void
+bench_properties_changed (gpointer user_data)
+{
+  PropsBench *bench = user_data;
+  g_autoptr(GVariant) variant = NULL;
+
+  variant = g_variant_ref_sink (build_properties_changed (bench->data, bench->mask,
+                                                          POWER_PROFILES_IFACE_NAME));
+  /* Serialize, as sending it on the bus would */
+  sink += GPOINTER_TO_SIZE (g_variant_get_data (variant));
+}
+
+static void
+bench_hold_add_release (gpointer user_data)
+{
+  PpdApp *data = user_data;
+  PpdClient *client = g_hash_table_lookup (data->clients, BENCH_CLIENT);
+  guint cookie = next_hold_cookie (data);
+
+  add_profile_hold (data, client, cookie,
+                    bench_hold_new (PPD_PROFILE_POWER_SAVER, "org.example.Bench", BENCH_CLIENT));
+  release_profile_hold (data, cookie);
+}
+
+static void
+bench_effective_hold_profile (gpointer user_data)
+{
+  PpdApp *data = user_data;
+
+  sink += effective_hold_profile (data);
+}
+
+static void
+bench_client_vanished (gpointer user_data)
+{
+  PpdApp *data = user_data;
+  PpdClient *client = client_new (data, BENCH_CLIENT);
+
+  for (guint i = 0; i < 1000; i++) {
+    add_profile_hold (data, client, next_hold_cookie (data),
+                      bench_hold_new (PPD_PROFILE_POWER_SAVER, "org.example.Bench", BENCH_CLIENT));
+  }
+  client_vanished (data->connection, BENCH_CLIENT, data);
+}
+
+static void
+run_benchmark (const Benchmark *bench,
+               GString         *json)
+{
+  guint64 iterations = 0;
+  guint64 batch = 1;
+  gint64 elapsed = 0;
+  gdouble ns_per_iter;
+  char buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  /* Warm up caches and lazily initialised state */
+  bench->func (bench->user_data);
+
+  /* Double the batch until a run lasts long enough to be measured */
+  while (elapsed < min_time) {
+    gint64 start = g_get_monotonic_time ();
+
+    for (guint64 i = 0; i < batch; i++)
+      bench->func (bench->user_data);
+    elapsed += g_get_monotonic_time () - start;
+    iterations += batch;
+    batch *= 2;
+  }
+
+  ns_per_iter = (gdouble) elapsed * 1000.0 / iterations;
+
+  if (json) {
+    if (json->len > 0)
+      g_string_append (json, ",\n");
+    g_string_append_printf (json,
+                            "    {\"name\": \"%s\", \"iterations\": %" G_GUINT64_FORMAT ", \"ns_per_iter\": %s}",
+                            bench->name, iterations,
+                            g_ascii_formatd (buf, sizeof (buf), "%.1f", ns_per_iter));
+  } else {
+    g_print ("%-40s %12" G_GUINT64_FORMAT " %14.1f ns/iter\n",
+             bench->name, iterations, ns_per_iter);
+  }
+}
+
+static char *
+create_cpuinfo (const char *dir)
+{
+  g_autoptr(GString) cpuinfo = g_string_new (NULL);
+  g_autofree char *proc = g_build_filename (dir, "proc", NULL);
+  g_autofree char *path = g_build_filename (proc, "cpuinfo", NULL);
+
+  for (guint i = 0; i < 256; i++) {
+    g_string_append_printf (cpuinfo,
+                            "processor\t: %u\n"
+                            "vendor_id\t: GenuineIntel\n"
+                            "cpu family\t: 6\n"
+                            "model name\t: Benchmark CPU\n"
+                            "flags\t\t: fpu vme de pse tsc msr pae mce cx8 apic sep mtrr pge mca cmov\n"
+                            "\n", i);
+  }
+
+  if (g_mkdir_with_parents (proc, 0755) < 0 ||
+      !g_file_set_contents (path, cpuinfo->str, cpuinfo->len, NULL))
+    g_error ("Could not create %s", path);
+
+  return g_steal_pointer (&path);
+}
+
+int main (int argc, char **argv)
+{
+  g_autoptr(GOptionContext) option_context = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GString) json = NULL;
+  g_autofree char *tmpdir = NULL;
+  g_autofree char *cpuinfo = NULL;
+  g_autofree char *proc = NULL;
+  gboolean json_output = FALSE;
+  gint min_time_ms = 200;
+  const char *filter = NULL;
+  g_autoptr(GDBusConnection) server = NULL;
+  PpdApp *app, *app_holds, *app_hold_changes, *app_vanish;
+  PropsBench props_profile, props_all;
+  WriteBench writes = { 0 };
+  const GOptionEntry options[] = {
+    { "json", 0, 0, G_OPTION_ARG_NONE, &json_output, "Print the results as JSON", NULL },
+    { "min-time", 0, 0, G_OPTION_ARG_INT, &min_time_ms, "Minimum time for each benchmark, in milliseconds", "MS" },
+    { NULL}
+  };
+
+  option_context = g_option_context_new ("[FILTER]");
+  g_option_context_set_summary (option_context, "Run the power-profiles-daemon microbenchmarks");
+  g_option_context_add_main_entries (option_context, options, NULL);
+  if (!g_option_context_parse (option_context, &argc, &argv, &error)) {
+    g_printerr ("Failed to parse arguments: %s\n", error->message);
+    return EXIT_FAILURE;
+  }
+  if (argc > 1)
+    filter = argv[1];
+  min_time = MAX (min_time_ms, 1) * G_TIME_SPAN_MILLISECOND;
+
+  tmpdir = g_dir_make_tmp ("ppd-microbench-XXXXXX", &error);
+  if (tmpdir == NULL) {
+    g_printerr ("Failed to create temporary directory: %s\n", error->message);
+    return EXIT_FAILURE;
+  }
+  /* Redirects the sysfs and procfs paths, as in the test suite */
+  cpuinfo = create_cpuinfo (tmpdir);
+  g_setenv ("UMOCKDEV_DIR", tmpdir, TRUE);
+
+  writes.dir = g_build_filename (tmpdir, "cpufreq", NULL);
+  g_mkdir_with_parents (writes.dir, 0755);
+  writes.path = g_build_filename (writes.dir, "energy_performance_preference", NULL);
+  writes.paths = g_ptr_array_new_with_free_func (g_free);
+  for (guint i = 0; i < 64; i++) {
+    char *path = g_strdup_printf ("%s/policy%u", writes.dir, i);
+
+    if (!g_file_set_contents (path, "", 0, NULL))
+      g_error ("Could not create %s", path);
+    g_ptr_array_add (writes.paths, path);
+  }
+  if (!g_file_set_contents (writes.path, "", 0, NULL))
+    g_error ("Could not create %s", writes.path);
+
+  app = create_app (0);
+  app_holds = create_app (10000);
+  /* Properties stay frozen, as while applying a batch, so that the hold
+   * benchmarks measure the bookkeeping and not the serialization of
+   * ActiveProfileHolds, which is measured on its own */
+  app_hold_changes = create_app (10000);
+  app_hold_changes->connection = create_connection (&server);
+  app_hold_changes->props_freeze_count = 1;
+  client_new (app_hold_changes, BENCH_CLIENT);
+  app_vanish = create_app (10000);
+  app_vanish->connection = g_object_ref (app_hold_changes->connection);
+  app_vanish->props_freeze_count = 1;
+  props_profile = (PropsBench) { app, PROP_ACTIVE_PROFILE };
+  props_all = (PropsBench) { app_holds, PROP_ALL };
+
+  {
+    const Benchmark benchmarks[] = {
+      { "utils-write", bench_utils_write, &writes },
+      { "utils-write-files-64", bench_utils_write_files, &writes },
+      { "utils-match-cpu-vendor-256-cpus", bench_match_cpu_vendor, NULL },
+      { "profile-from-str", bench_profile_from_str, NULL },
+      { "profiles-variant", bench_profiles_variant, app },
+      { "profile-holds-variant-10000", bench_holds_variant, app_holds },
+      { "properties-changed-active-profile", bench_properties_changed, &props_profile },
+      { "properties-changed-all-10000-holds", bench_properties_changed, &props_all },
+      { "hold-add-release-10000-holds", bench_hold_add_release, app_hold_changes },
+      { "effective-hold-profile-10000-holds", bench_effective_hold_profile, app_holds },
+      { "client-vanished-1000-of-11000-holds", bench_client_vanished, app_vanish },
+    };
+
+    if (json_output)
+      json = g_string_new (NULL);
+
+    for (guint i = 0; i < G_N_ELEMENTS (benchmarks); i++) {
+      if (filter && !strstr (benchmarks[i].name, filter))
+        continue;
+      run_benchmark (&benchmarks[i], json);
+    }
+  }
+
+  if (json)
+    g_print ("{\n  \"benchmarks\": [\n%s\n  ]\n}\n", json->str);
+
+  free_app (app);
+  free_app (app_holds);
+  free_app (app_hold_changes);
+  free_app (app_vanish);
+  g_dbus_connection_close_sync (server, NULL, NULL);
+  for (guint i = 0; i < writes.paths->len; i++)
+    g_unlink (g_ptr_array_index (writes.paths, i));
+  g_ptr_array_unref (writes.paths);
+  g_unlink (writes.path);
+  g_rmdir (writes.dir);
+  g_free (writes.path);
+  g_free (writes.dir);
+  g_unlink (cpuinfo);
+  proc = g_path_get_dirname (cpuinfo);
+  g_rmdir (proc);
+  g_rmdir (tmpdir);
+
+  return EXIT_SUCCESS;
+}
@@ -12,18 +12,40 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
 #include <glib-unix.h>
+#include <glib/gstdio.h>
 #include <locale.h>
 #include <polkit/polkit.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBSYSTEMD
+#include <systemd/sd-daemon.h>
+#include <systemd/sd-login.h>
+#endif
 
 #include "power-profiles-daemon-resources.h"
 #include "power-profiles-daemon.h"
 #include "ppd-driver-cpu.h"
 #include "ppd-driver-platform.h"
 #include "ppd-action.h"
+#include "ppd-energy.h"
 #include "ppd-enums.h"
+#include "ppd-metrics.h"
+#include "ppd-recorder.h"
+#include "ppd-stats.h"
+#include "ppd-trace.h"
+#include "ppd-watchdog.h"
+#ifdef HAVE_MODULES
+#include "ppd-modules.h"
+#endif
 
 #define POWER_PROFILES_DBUS_NAME          "org.freedesktop.UPower.PowerProfiles"
 #define POWER_PROFILES_DBUS_PATH          "/org/freedesktop/UPower/PowerProfiles"
@@ -37,6 +59,13 @@
 
 #define POWER_PROFILES_RESOURCES_PATH "/org/freedesktop/UPower/PowerProfiles"
 
+#define POWER_PROFILES_PEER_SOCKET_PATH   "/run/power-profiles-daemon/socket"
+#define POWER_PROFILES_METRICS_PATH       "/run/power-profiles-daemon/metrics"
+
+/* The peer socket is world-writable */
+#define MAX_PEERS                         64
+#define MAX_PEERS_PER_USER                8
+
 #define UPOWER_DBUS_NAME                  "org.freedesktop.UPower"
 #define UPOWER_DBUS_PATH                  "/org/freedesktop/UPower"
 #define UPOWER_DBUS_INTERFACE             "org.freedesktop.UPower"
@@ -48,6 +77,18 @@
 #define LOGIND_DBUS_PATH                  "/org/freedesktop/login1"
 #define LOGIND_DBUS_INTERFACE             "org.freedesktop.login1.Manager"
 
+#define SYSTEMD_DBUS_NAME                 "org.freedesktop.systemd1"
+#define SYSTEMD_DBUS_PATH                 "/org/freedesktop/systemd1"
+#define SYSTEMD_DBUS_INTERFACE            "org.freedesktop.systemd1.Manager"
+#define SYSTEMD_CALL_TIMEOUT_MSEC         250
+
+#define CONFIG_SAVE_DELAY_MSEC 500
+#define SAVED_STATE_FD_NAME "ppd-state"
+#define SETTINGS_RELOAD_DELAY_MSEC 250
+
+/* How long a positive polkit decision is trusted without asking again */
+#define AUTH_CACHE_TTL_USEC               (30 * G_USEC_PER_SEC)
+
 #ifndef POLKIT_HAS_AUTOPOINTERS
 /* FIXME: Remove this once we're fine to depend on polkit 0.114 */
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (PolkitAuthorizationResult, g_object_unref)
@@ -60,23 +101,79 @@ typedef struct {
   gboolean replace;
   gboolean disable_upower;
   gboolean disable_logind;
+  gboolean disable_legacy_name;
+  gboolean peer_socket;
+  gboolean metrics_socket;
+  gint max_holds_per_client;
+  gdouble hold_rate_limit;
+  gint hold_rate_burst;
+  gint idle_exit_timeout;
+  gint stall_threshold;
+  gint restore_state_fd;
   GStrv blocked_drivers;
   GStrv blocked_actions;
 } DebugOptions;
 
+/* The command line options, as amended by the administrator's configuration */
+typedef struct {
+  GStrv blocked_drivers;
+  GStrv blocked_actions;
+  gint max_holds_per_client;
+  gdouble hold_rate_limit;
+  gint hold_rate_burst;
+} PpdSettings;
+
 typedef struct {
   GMainLoop *main_loop;
   GDBusConnection *connection;
   GCancellable *cancellable;
   guint name_id;
   guint legacy_name_id;
+  gboolean legacy_seen;
   gboolean was_started;
+  GDBusServer *peer_server;
+  char *peer_socket_path;
+  GDBusInterfaceInfo *peer_interface;
+  GDBusInterfaceInfo *interface_info;
+  GDBusInterfaceInfo *legacy_interface_info;
+  GPtrArray *peers;
+  guint last_peer_id;
+  guint props_freeze_count;
+  guint pending_props;
   int ret;
 
+  PpdSettings *settings;
+  char *settings_dir;
+  GFileMonitor *settings_monitor;
+  guint settings_reload_id;
+  gboolean preserve_holds;
+  guint idle_exit_id;
+  GStrv argv;
+  GVariant *saved_state;
+
+  gint64 startup_time;
+  gint64 startup_mark;
+  GArray *startup_phases;
+  guint startup_pending;
+  gboolean ready;
+
   GKeyFile *config;
+  guint config_save_id;
+  guint config_generation;
   char *config_path;
 
+  PpdStats *stats;
+  PpdMetrics *metrics;
+  GSocketService *metrics_service;
+  char *metrics_path;
+  PpdEnergy *energy;
+
   PolkitAuthority *auth;
+  gulong auth_changed_id;
+  /* Non-zero while connecting to polkit */
+  gint64 auth_requested;
+  GQueue *pending_calls;
+  GHashTable *clients;
 
   PpdProfile active_profile;
   PpdProfile selected_profile;
@@ -85,6 +182,8 @@ typedef struct {
   PpdDriverPlatform *platform_driver;
   GPtrArray *actions;
   GHashTable *profile_holds;
+  guint profile_hold_counts[NUM_PROFILES];
+  guint last_cookie;
 
   gboolean battery_support;
   GDBusProxy *upower_proxy;
@@ -108,6 +207,22 @@ typedef struct {
   char *requester_iface;
 } ProfileHold;
 
+typedef struct {
+  char *name;
+  gint64 duration;
+} StartupPhase;
+
+typedef struct {
+  char *name;
+  guint watch_id;
+  GDBusConnection *connection;
+  PolkitSubject *subject;
+  GHashTable *authorizations;
+  GHashTable *holds;
+  gdouble hold_tokens;
+  gint64 hold_tokens_time;
+} PpdClient;
+
 static void
 debug_options_free(DebugOptions *options)
 {
@@ -117,6 +232,23 @@ debug_options_free(DebugOptions *options)
 }
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (DebugOptions, debug_options_free)
 
+static void
+settings_free (PpdSettings *settings)
+{
+  if (settings == NULL)
+    return;
+  g_strfreev (settings->blocked_drivers);
+  g_strfreev (settings->blocked_actions);
+  g_free (settings);
+}
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (PpdSettings, settings_free)
+
+static void
+startup_phase_clear (StartupPhase *phase)
+{
+  g_free (phase->name);
+}
+
 static void
 profile_hold_free (ProfileHold *hold)
 {
@@ -129,39 +261,35 @@ profile_hold_free (ProfileHold *hold)
   g_free (hold);
 }
 
+static void
+client_free (PpdClient *client)
+{
+  if (client == NULL)
+    return;
+  g_clear_handle_id (&client->watch_id, g_bus_unwatch_name);
+  g_clear_object (&client->subject);
+  g_clear_pointer (&client->authorizations, g_hash_table_unref);
+  g_clear_pointer (&client->holds, g_hash_table_unref);
+  g_free (client->name);
+  g_free (client);
+}
+
 static PpdApp *ppd_app = NULL;
 
 static void stop_profile_drivers (PpdApp *data);
 static void start_profile_drivers (PpdApp *data);
 static void upower_battery_set_power_changed_reason (PpdApp *, PpdPowerChangedReason);
+static void upower_monitor_start (PpdApp *data);
+static void upower_monitor_connect (PpdApp *data, gboolean needs_battery_state_monitor, gboolean needs_battery_change_monitor);
+static void upower_monitor_stop (PpdApp *data);
+static gboolean action_blocked (PpdApp *app, PpdAction *action);
 
-/* profile drivers and actions */
-//#include "ppd-action-trickle-charge.h"
-//#include "ppd-action-amdgpu-panel-power.h"
-//#include "ppd-action-amdgpu-dpm.h"
-#include "ppd-driver-placeholder.h"
-//#include "ppd-driver-platform-profile.h"
-#include "ppd-driver-fake.h"
-#include "ppd-driver-tlpmm.h"
-#include "ppd-driver-tlp.h"
-#include "ppd-driver-pwrmdr.h"
-
+#ifndef HAVE_MODULES
 typedef GType (*GTypeGetFunc) (void);
 
-static GTypeGetFunc objects[] = {
-  /* Hardware specific profile drivers */
-  ppd_driver_fake_get_type,
-   ppd_driver_pwrmdr_get_type,
-  ppd_driver_tlpmm_get_type,
-  ppd_driver_tlp_get_type,
-  /* Generic profile driver */
-  ppd_driver_placeholder_get_type,
-
-  /* Actions */
-  //ppd_action_trickle_charge_get_type,
-  //ppd_action_amdgpu_panel_power_get_type,
-  //ppd_action_amdgpu_dpm_get_type,
-};
+/* objects[], as selected with the "drivers" and "actions" build options */
+#include "ppd-registry.h"
+#endif
 
 typedef enum {
   PROP_ACTIVE_PROFILE             = 1 << 0,
@@ -353,21 +481,49 @@ get_profile_holds_variant (PpdApp *data)
   return g_variant_builder_end (&builder);
 }
 
+static GVariant *
+get_statistics_variant (PpdApp *data)
+{
+  g_autoptr(GVariant) stats = g_variant_ref_sink (ppd_stats_get_variant (data->stats));
+  g_auto(GVariantDict) dict = G_VARIANT_DICT_INIT (stats);
+
+  g_variant_dict_insert_value (&dict, "Stalls", ppd_watchdog_get_variant ());
+
+  return g_variant_dict_end (&dict);
+}
+
 static void
-send_dbus_event_iface (PpdApp         *data,
-                       PropertiesMask  mask,
-                       const gchar    *iface,
-                       const gchar    *path)
+emit_signal (PpdApp      *data,
+             const gchar *path,
+             const gchar *iface,
+             const gchar *signal_name,
+             GVariant    *parameters)
 {
-  GVariantBuilder props_builder;
-  GVariant *props_changed = NULL;
+  g_autoptr(GVariant) params = g_variant_ref_sink (parameters);
+  gint64 start = g_get_monotonic_time ();
 
-  g_return_if_fail (data->connection);
+  g_dbus_connection_emit_signal (data->connection, NULL, path, iface, signal_name,
+                                 params, NULL);
 
-  if (mask == 0)
-    return;
+  /* Peers only get the current interface */
+  if (g_str_equal (path, POWER_PROFILES_DBUS_PATH)) {
+    for (guint i = 0; i < data->peers->len; i++) {
+      GDBusConnection *peer = g_ptr_array_index (data->peers, i);
 
-  g_return_if_fail ((mask & PROP_ALL) != 0);
+      g_dbus_connection_emit_signal (peer, NULL, path, iface, signal_name, params, NULL);
+    }
+  }
+
+  ppd_stats_record (data->stats, "signal", signal_name, g_get_monotonic_time () - start);
+}
+
+/* The parameters of the PropertiesChanged signal for @mask on @iface */
+static GVariant *
+build_properties_changed (PpdApp         *data,
+                          PropertiesMask  mask,
+                          const gchar    *iface)
+{
+  GVariantBuilder props_builder;
 
   g_variant_builder_init (&props_builder, G_VARIANT_TYPE ("a{sv}"));
 
@@ -409,35 +565,357 @@ send_dbus_event_iface (PpdApp         *data,
                            g_variant_new_boolean (data->battery_support));
   }
 
-  props_changed = g_variant_new ("(s@a{sv}@as)", iface,
-                                 g_variant_builder_end (&props_builder),
-                                 g_variant_new_strv (NULL, 0));
+  return g_variant_new ("(s@a{sv}@as)", iface,
+                        g_variant_builder_end (&props_builder),
+                        g_variant_new_strv (NULL, 0));
+}
+
+static void
+send_dbus_event_iface (PpdApp         *data,
+                       PropertiesMask  mask,
+                       const gchar    *iface,
+                       const gchar    *path)
+{
+  GVariant *props_changed = NULL;
+
+  g_return_if_fail (data->connection);
+
+  if (mask == 0)
+    return;
+
+  g_return_if_fail ((mask & PROP_ALL) != 0);
+
+  props_changed = build_properties_changed (data, mask, iface);
+  emit_signal (data, path, "org.freedesktop.DBus.Properties", "PropertiesChanged",
+               props_changed);
+}
+
+static void
+update_metrics (PpdApp         *data,
+                PropertiesMask  mask)
+{
+  if (data->metrics == NULL)
+    return;
 
-  g_dbus_connection_emit_signal (data->connection,
-                                 NULL,
-                                 path,
-                                 "org.freedesktop.DBus.Properties",
-                                 "PropertiesChanged",
-                                 props_changed, NULL);
+  if (mask & PROP_ACTIVE_PROFILE)
+    ppd_metrics_set_profile (data->metrics, data->active_profile);
+  if (mask & PROP_DEGRADED) {
+    g_autofree char *degraded = get_performance_degraded (data);
+    ppd_metrics_set_degraded (data->metrics, degraded);
+  }
 }
 
 static void
 send_dbus_event (PpdApp         *data,
                  PropertiesMask  mask)
 {
+  if (mask & PROP_ACTIVE_PROFILE)
+    ppd_energy_set_profile (data->energy, data->active_profile);
+  update_metrics (data, mask);
+
+  if (data->props_freeze_count > 0) {
+    data->pending_props |= mask;
+    return;
+  }
+
   send_dbus_event_iface (data, mask,
                          POWER_PROFILES_IFACE_NAME,
                          POWER_PROFILES_DBUS_PATH);
+
+  /* Nobody asked for the legacy interface, so nobody is listening either */
+  if (!data->legacy_seen)
+    return;
+
   send_dbus_event_iface (data, mask,
                          POWER_PROFILES_LEGACY_IFACE_NAME,
                          POWER_PROFILES_LEGACY_DBUS_PATH);
 }
 
 static void
-save_configuration (PpdApp *data)
+freeze_dbus_events (PpdApp *data)
+{
+  data->props_freeze_count++;
+}
+
+static void
+thaw_dbus_events (PpdApp *data)
+{
+  PropertiesMask mask;
+
+  g_return_if_fail (data->props_freeze_count > 0);
+
+  if (--data->props_freeze_count > 0)
+    return;
+
+  mask = data->pending_props;
+  data->pending_props = 0;
+  send_dbus_event (data, mask);
+}
+
+static void startup_phase_done (PpdApp *data, gint64 start, const char *format, ...) G_GNUC_PRINTF (3, 4);
+
+static void
+startup_phase_done (PpdApp     *data,
+                    gint64      start,
+                    const char *format,
+                    ...)
+{
+  StartupPhase phase;
+  va_list args;
+
+  /* Later restarts of the drivers are not part of the startup */
+  if (data->ready)
+    return;
+
+  va_start (args, format);
+  phase.name = g_strdup_vprintf (format, args);
+  va_end (args);
+  phase.duration = g_get_monotonic_time () - start;
+  g_array_append_val (data->startup_phases, phase);
+}
+
+static GVariant *
+get_startup_timings_variant (PpdApp *data)
+{
+  GVariantBuilder builder;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(st)"));
+
+  for (guint i = 0; data->ready && i < data->startup_phases->len; i++) {
+    StartupPhase *phase = &g_array_index (data->startup_phases, StartupPhase, i);
+
+    g_variant_builder_add (&builder, "(st)", phase->name, (guint64) phase->duration);
+  }
+
+  return g_variant_builder_end (&builder);
+}
+
+static void
+startup_check_ready (PpdApp *data)
+{
+  g_autoptr(GString) summary = NULL;
+  gint64 total;
+
+  if (data->ready || !data->was_started || data->auth_requested != 0 ||
+      data->startup_pending > 0)
+    return;
+
+  /* Exiting because of missing drivers */
+  if (data->ret != EXIT_SUCCESS)
+    return;
+
+  if (data->startup_mark != 0) {
+    startup_phase_done (data, data->startup_mark, "upower");
+    data->startup_mark = 0;
+  }
+
+  summary = g_string_new (NULL);
+  for (guint i = 0; i < data->startup_phases->len; i++) {
+    StartupPhase *phase = &g_array_index (data->startup_phases, StartupPhase, i);
+
+    g_string_append_printf (summary, "%s%s %.1f ms", i > 0 ? ", " : "",
+                            phase->name, phase->duration / 1000.0);
+  }
+
+  total = g_get_monotonic_time () - data->startup_time;
+  startup_phase_done (data, data->startup_time, "total");
+  data->ready = TRUE;
+
+  g_info ("Ready after %.1f ms (%s)", total / 1000.0, summary->str);
+
+#ifdef HAVE_LIBSYSTEMD
+  sd_notifyf (0, "READY=1\nSTATUS=Profile '%s' active, ready after %.1f ms",
+              get_active_profile (data), total / 1000.0);
+#endif
+}
+
+static void
+startup_upower_done (PpdApp *data)
+{
+  if (data->startup_pending == 0)
+    return;
+
+  data->startup_pending--;
+  startup_check_ready (data);
+}
+
+typedef struct {
+  char *path;
+  char *contents;
+  gsize length;
+  guint generation;
+  gboolean superseded;
+  PpdStats *stats;
+} ConfigWrite;
+
+/* Serializes writers, and makes sure an older state never replaces a newer one */
+static GMutex config_write_lock;
+static GCond config_write_cond;
+static guint config_written_generation;
+static guint config_writes_in_flight;
+
+static void
+config_write_free (ConfigWrite *write)
+{
+  g_free (write->path);
+  g_free (write->contents);
+  ppd_stats_unref (write->stats);
+  g_free (write);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (ConfigWrite, config_write_free)
+
+static ConfigWrite *
+config_write_new (PpdApp *data)
+{
+  ConfigWrite *write;
+
+  write = g_new0 (ConfigWrite, 1);
+  write->path = g_strdup (data->config_path);
+  write->contents = g_key_file_to_data (data->config, &write->length, NULL);
+  write->generation = ++data->config_generation;
+  write->stats = ppd_stats_ref (data->stats);
+
+  return write;
+}
+
+static gboolean
+config_write_run (ConfigWrite  *write,
+                  GError      **error)
+{
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&config_write_lock);
+  gint64 start;
+
+  if (write->generation < config_written_generation) {
+    write->superseded = TRUE;
+    return TRUE;
+  }
+
+  /* Writes to a temporary file, and renames it over the old one */
+  start = g_get_monotonic_time ();
+  if (!g_file_set_contents (write->path, write->contents, write->length, error))
+    return FALSE;
+  ppd_stats_record (write->stats, "persistence", "state-file", g_get_monotonic_time () - start);
+
+  config_written_generation = write->generation;
+  return TRUE;
+}
+
+static void
+config_write_thread (GTask        *task,
+                     gpointer      source_object,
+                     gpointer      task_data,
+                     GCancellable *cancellable)
+{
+  g_autoptr(GError) error = NULL;
+  gboolean ret;
+
+  ret = config_write_run (task_data, &error);
+
+  g_mutex_lock (&config_write_lock);
+  config_writes_in_flight--;
+  g_cond_broadcast (&config_write_cond);
+  g_mutex_unlock (&config_write_lock);
+
+  if (!ret)
+    g_task_return_error (task, g_steal_pointer (&error));
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+static void
+config_write_done (GObject      *source_object,
+                   GAsyncResult *res,
+                   gpointer      user_data)
+{
+  ConfigWrite *write = g_task_get_task_data (G_TASK (res));
+  g_autoptr(GError) error = NULL;
+  PpdApp *data = user_data;
+
+  if (!g_task_propagate_boolean (G_TASK (res), &error)) {
+    g_warning ("Could not save configuration file '%s': %s", write->path, error->message);
+    return;
+  }
+
+  /* A newer write was done first, so there was nothing left to write */
+  if (write->superseded)
+    ppd_stats_count (data->stats, "config-saves-superseded");
+  else
+    ppd_stats_count (data->stats, "config-saves-written");
+}
+
+static gboolean
+config_save_timeout (gpointer user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  PpdApp *data = user_data;
+
+  data->config_save_id = 0;
+
+  task = g_task_new (NULL, NULL, config_write_done, data);
+  g_task_set_source_tag (task, config_save_timeout);
+  g_task_set_task_data (task, config_write_new (data), (GDestroyNotify) config_write_free);
+
+  g_mutex_lock (&config_write_lock);
+  config_writes_in_flight++;
+  g_mutex_unlock (&config_write_lock);
+
+  g_task_run_in_thread (task, config_write_thread);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_config_write (PpdApp *data)
+{
+  ppd_stats_count (data->stats, "config-saves-requested");
+
+  /* Merged into the save that is already scheduled */
+  if (data->config_save_id != 0) {
+    ppd_stats_count (data->stats, "config-saves-merged");
+    return;
+  }
+
+  data->config_save_id = ppd_watchdog_timeout_add (CONFIG_SAVE_DELAY_MSEC, "config-save",
+                                                   config_save_timeout, data);
+}
+
+static gboolean
+config_writes_pending (PpdApp *data)
 {
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&config_write_lock);
+
+  return data->config_save_id != 0 || config_writes_in_flight > 0;
+}
+
+static void
+flush_configuration (PpdApp *data)
+{
+  g_autoptr(ConfigWrite) write = NULL;
   g_autoptr(GError) error = NULL;
 
+  /* Don't quit in the middle of a background write */
+  g_mutex_lock (&config_write_lock);
+  while (config_writes_in_flight > 0)
+    g_cond_wait (&config_write_cond, &config_write_lock);
+  g_mutex_unlock (&config_write_lock);
+
+  if (data->config_save_id == 0)
+    return;
+
+  g_clear_handle_id (&data->config_save_id, g_source_remove);
+
+  g_debug ("Flushing pending configuration changes to '%s'", data->config_path);
+  write = config_write_new (data);
+  if (!config_write_run (write, &error))
+    g_warning ("Could not save configuration file '%s': %s", write->path, error->message);
+  else
+    ppd_stats_count (data->stats, "config-saves-written");
+}
+
+static void
+save_configuration (PpdApp *data)
+{
   if (PPD_IS_DRIVER_CPU (data->cpu_driver)) {
     g_key_file_set_string (data->config, "State", "CpuDriver",
                            ppd_driver_get_driver_name (PPD_DRIVER (data->cpu_driver)));
@@ -460,8 +938,7 @@ save_configuration (PpdApp *data)
 
   g_key_file_set_boolean (data->config, "State", "battery_aware", data->battery_support);
 
-  if (!g_key_file_save_to_file (data->config, data->config_path, &error))
-    g_warning ("Could not save configuration file '%s': %s", data->config_path, error->message);
+  schedule_config_write (data);
 }
 
 static gboolean
@@ -525,9 +1002,10 @@ load_configuration (PpdApp *data)
 }
 
 static void
-actions_activate_profile (GPtrArray *actions,
-                          PpdProfile profile)
+actions_activate_profile (PpdApp     *data,
+                          PpdProfile  profile)
 {
+  GPtrArray *actions = data->actions;
   guint i;
 
   g_return_if_fail (actions != NULL);
@@ -535,13 +1013,23 @@ actions_activate_profile (GPtrArray *actions,
   for (i = 0; i < actions->len; i++) {
     g_autoptr(GError) error = NULL;
     PpdAction *action;
+    gboolean ret;
+    gint64 start;
 
     action = g_ptr_array_index (actions, i);
 
     if (!ppd_action_get_active (action))
       continue;
 
-    if (!ppd_action_activate_profile (action, profile, &error))
+    start = g_get_monotonic_time ();
+    PPD_TRACE2 (action_activate_start, ppd_action_get_action_name (action), profile);
+    ret = ppd_action_activate_profile (action, profile, &error);
+    PPD_TRACE3 (action_activate_done, ppd_action_get_action_name (action), profile, ret);
+    ppd_stats_record (data->stats, "action", ppd_action_get_action_name (action),
+                      g_get_monotonic_time () - start);
+    ppd_recorder_record (PPD_EVENT_ACTION, ppd_action_get_action_name (action), profile, ret,
+                         g_get_monotonic_time () - start, ret ? NULL : error->message);
+    if (!ret)
       g_warning ("Failed to activate action '%s' to profile %s: %s",
                  ppd_profile_to_str (profile),
                  ppd_action_get_action_name (action),
@@ -549,6 +1037,41 @@ actions_activate_profile (GPtrArray *actions,
   }
 }
 
+static gboolean
+driver_activate_profile (PpdApp                      *data,
+                         PpdDriver                   *driver,
+                         PpdProfile                   profile,
+                         PpdProfileActivationReason   reason,
+                         GError                     **error)
+{
+  gint64 start = g_get_monotonic_time ();
+  gboolean ret;
+
+  PPD_TRACE2 (driver_activate_start, ppd_driver_get_driver_name (driver), profile);
+  ret = ppd_driver_activate_profile (driver, profile, reason, error);
+  PPD_TRACE3 (driver_activate_done, ppd_driver_get_driver_name (driver), profile, ret);
+  ppd_stats_record (data->stats, "driver", ppd_driver_get_driver_name (driver),
+                    g_get_monotonic_time () - start);
+  ppd_recorder_record (PPD_EVENT_DRIVER, ppd_driver_get_driver_name (driver), profile, ret,
+                       g_get_monotonic_time () - start,
+                       !ret && error && *error ? (*error)->message : NULL);
+
+  return ret;
+}
+
+static void
+record_activation (PpdProfile                   target_profile,
+                   PpdProfileActivationReason   reason,
+                   gint64                       start,
+                   gboolean                     ret,
+                   GError                     **error)
+{
+  PPD_TRACE3 (activate_done, target_profile, reason, ret);
+  ppd_recorder_record (PPD_EVENT_PROFILE, ppd_profile_activation_reason_to_str (reason),
+                       target_profile, ret, g_get_monotonic_time () - start,
+                       !ret && error && *error ? (*error)->message : NULL);
+}
+
 static gboolean
 activate_target_profile (PpdApp                      *data,
                          PpdProfile                   target_profile,
@@ -556,32 +1079,37 @@ activate_target_profile (PpdApp                      *data,
                          GError                     **error)
 {
   PpdProfile current_profile = data->active_profile;
+  gint64 start = g_get_monotonic_time ();
 
   g_info ("Setting active profile '%s' for reason '%s' (current: '%s')",
            ppd_profile_to_str (target_profile),
            ppd_profile_activation_reason_to_str (reason),
            ppd_profile_to_str (current_profile));
+  PPD_TRACE3 (activate_start, target_profile, reason, current_profile);
 
   /* Try CPU first */
   if (driver_profile_support (PPD_DRIVER (data->cpu_driver), target_profile) &&
-      !ppd_driver_activate_profile (PPD_DRIVER (data->cpu_driver),
-                                    target_profile, reason, error)) {
+      !driver_activate_profile (data, PPD_DRIVER (data->cpu_driver),
+                                target_profile, reason, error)) {
     g_prefix_error (error, "Failed to activate CPU driver '%s': ",
                     ppd_driver_get_driver_name (PPD_DRIVER (data->cpu_driver)));
+    record_activation (target_profile, reason, start, FALSE, error);
     return FALSE;
   }
 
   /* Then try platform */
   if (driver_profile_support (PPD_DRIVER (data->platform_driver), target_profile) &&
-      !ppd_driver_activate_profile (PPD_DRIVER (data->platform_driver),
-                                                target_profile, reason, error)) {
+      !driver_activate_profile (data, PPD_DRIVER (data->platform_driver),
+                                target_profile, reason, error)) {
     g_autoptr(GError) recovery_error = NULL;
 
     g_prefix_error (error, "Failed to activate platform driver '%s': ",
                     ppd_driver_get_driver_name (PPD_DRIVER (data->platform_driver)));
 
-    if (!PPD_IS_DRIVER (data->cpu_driver))
+    if (!PPD_IS_DRIVER (data->cpu_driver)) {
+      record_activation (target_profile, reason, start, FALSE, error);
       return FALSE;
+    }
 
     g_debug ("Reverting CPU driver '%s' to profile '%s'",
               ppd_driver_get_driver_name (PPD_DRIVER (data->cpu_driver)),
@@ -595,17 +1123,30 @@ activate_target_profile (PpdApp                      *data,
                   recovery_error->message);
     }
 
+    record_activation (target_profile, reason, start, FALSE, error);
     return FALSE;
   }
 
-  actions_activate_profile (data->actions, target_profile);
+  actions_activate_profile (data, target_profile);
 
   data->active_profile = target_profile;
 
+  if (data->connection)
+    emit_signal (data, POWER_PROFILES_DBUS_PATH, POWER_PROFILES_IFACE_NAME, "ProfileChanged",
+                 g_variant_new ("(ss)",
+                                ppd_profile_to_str (target_profile),
+                                ppd_profile_activation_reason_to_str (reason)));
+
   if (reason == PPD_PROFILE_ACTIVATION_REASON_USER ||
       reason == PPD_PROFILE_ACTIVATION_REASON_INTERNAL)
     save_configuration (data);
 
+  ppd_stats_record (data->stats, "activation", ppd_profile_activation_reason_to_str (reason),
+                    g_get_monotonic_time () - start);
+  if (data->metrics)
+    ppd_metrics_count_switch (data->metrics, reason);
+  record_activation (target_profile, reason, start, TRUE, error);
+
   return TRUE;
 }
 
@@ -615,15 +1156,54 @@ release_hold_notify (PpdApp      *data,
                      guint        cookie)
 {
   const char *req_path = POWER_PROFILES_DBUS_PATH;
+  GDBusConnection *connection = data->connection;
+  const char *destination = hold->requester;
+  PpdClient *client;
 
   if (g_strcmp0 (hold->requester_iface, POWER_PROFILES_LEGACY_IFACE_NAME) == 0)
     req_path = POWER_PROFILES_LEGACY_DBUS_PATH;
 
-  g_dbus_connection_emit_signal (data->connection, hold->requester, req_path,
+  client = g_hash_table_lookup (data->clients, hold->requester);
+  if (client && client->connection) {
+    connection = client->connection;
+    destination = NULL;
+  }
+
+  g_dbus_connection_emit_signal (connection, destination, req_path,
                                  hold->requester_iface, "ProfileReleased",
                                  g_variant_new ("(u)", cookie), NULL);
 }
 
+static guint *
+profile_hold_count (PpdApp     *data,
+                    PpdProfile  profile)
+{
+  return &data->profile_hold_counts[g_bit_nth_lsf (profile, -1)];
+}
+
+/* Keeps the counts up to date as holds come and go, instead of
+ * walking all of them each time */
+static void
+count_profile_hold (PpdApp      *data,
+                    ProfileHold *hold,
+                    gint         delta)
+{
+  *profile_hold_count (data, hold->profile) += delta;
+  if (data->metrics)
+    ppd_metrics_add_holds (data->metrics, hold->application_id, delta);
+}
+
+static void
+add_profile_hold (PpdApp      *data,
+                  PpdClient   *client,
+                  guint        cookie,
+                  ProfileHold *hold)
+{
+  g_hash_table_add (client->holds, GUINT_TO_POINTER (cookie));
+  g_hash_table_insert (data->profile_holds, GUINT_TO_POINTER (cookie), hold);
+  count_profile_hold (data, hold, 1);
+}
+
 static void
 release_all_profile_holds (PpdApp *data)
 {
@@ -636,9 +1216,17 @@ release_all_profile_holds (PpdApp *data)
     guint cookie = GPOINTER_TO_UINT (key);
 
     release_hold_notify (data, hold, cookie);
-    g_bus_unwatch_name (cookie);
   }
   g_hash_table_remove_all (data->profile_holds);
+
+  g_hash_table_iter_init (&iter, data->clients);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    PpdClient *client = value;
+    g_hash_table_remove_all (client->holds);
+  }
+  memset (data->profile_hold_counts, 0, sizeof (data->profile_hold_counts));
+  if (data->metrics)
+    ppd_metrics_clear_holds (data->metrics);
 }
 
 static gboolean
@@ -650,11 +1238,23 @@ set_battery_support (PpdApp *data, gboolean battery_support, GError **error)
     return FALSE;
   }
 
+  if (battery_support && data->debug_options->disable_upower) {
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED,
+                 "upower integration is disabled");
+    return FALSE;
+  }
+
   data->battery_support = battery_support;
   g_key_file_set_boolean (data->config, "State", "battery_aware", data->battery_support);
   g_debug("battery_aware set to %s", data->battery_support ? "TRUE" : "FALSE");
 
-  restart_profile_drivers_for_default_app ();
+  if (battery_support)
+    upower_monitor_start (data);
+  else
+    upower_monitor_stop (data);
+
+  send_dbus_event (data, PROP_UPOWER);
+  save_configuration (data);
 
   return TRUE;
 }
@@ -702,21 +1302,12 @@ set_active_profile (PpdApp      *data,
 static PpdProfile
 effective_hold_profile (PpdApp *data)
 {
-  GHashTableIter iter;
-  gpointer value;
-  PpdProfile profile = PPD_PROFILE_UNSET;
-
-  g_hash_table_iter_init (&iter, data->profile_holds);
-  while (g_hash_table_iter_next (&iter, NULL, &value)) {
-    ProfileHold *hold = value;
-
-    if (hold->profile == PPD_PROFILE_POWER_SAVER) {
-      profile = PPD_PROFILE_POWER_SAVER;
-      break;
-    }
-    profile = hold->profile;
-  }
-  return profile;
+  /* power-saver holds win over performance ones */
+  if (*profile_hold_count (data, PPD_PROFILE_POWER_SAVER) > 0)
+    return PPD_PROFILE_POWER_SAVER;
+  if (*profile_hold_count (data, PPD_PROFILE_PERFORMANCE) > 0)
+    return PPD_PROFILE_PERFORMANCE;
+  return PPD_PROFILE_UNSET;
 }
 
 static void
@@ -727,6 +1318,7 @@ driver_performance_degraded_changed_cb (GObject    *gobject,
   PpdApp *data = user_data;
   PpdDriver *driver = PPD_DRIVER (gobject);
   const char *prop_str = pspec->name;
+  g_auto(PpdWatchdogScope) scope = ppd_watchdog_enter ("signal", "driver-degraded-changed");
 
   if (g_strcmp0 (prop_str, "performance-degraded") != 0) {
     g_warning ("Ignoring '%s' property change on profile driver '%s'",
@@ -749,6 +1341,7 @@ driver_profile_changed_cb (PpdDriver *driver,
                            gpointer   user_data)
 {
   PpdApp *data = user_data;
+  g_auto(PpdWatchdogScope) scope = ppd_watchdog_enter ("signal", "driver-profile-changed");
 
   g_debug ("Driver '%s' switched internally to profile '%s' (current: '%s')",
            ppd_driver_get_driver_name (driver),
@@ -767,6 +1360,7 @@ release_profile_hold (PpdApp *data,
 {
   guint mask = PROP_ACTIVE_PROFILE_HOLDS;
   ProfileHold *hold;
+  PpdClient *client;
   PpdProfile hold_profile, next_profile;
 
   hold = g_hash_table_lookup (data->profile_holds, GUINT_TO_POINTER (cookie));
@@ -775,8 +1369,13 @@ release_profile_hold (PpdApp *data,
     return;
   }
 
-  g_bus_unwatch_name (cookie);
+  client = g_hash_table_lookup (data->clients, hold->requester);
+  if (client)
+    g_hash_table_remove (client->holds, GUINT_TO_POINTER (cookie));
   hold_profile = hold->profile;
+  count_profile_hold (data, hold, -1);
+  PPD_TRACE2 (hold_release, cookie, hold_profile);
+  ppd_recorder_record (PPD_EVENT_RELEASE, hold->application_id, hold_profile, cookie, 0, NULL);
   release_hold_notify (data, hold, cookie);
   g_hash_table_remove (data->profile_holds, GUINT_TO_POINTER (cookie));
 
@@ -799,39 +1398,226 @@ release_profile_hold (PpdApp *data,
 }
 
 static void
-holder_disappeared (GDBusConnection *connection,
-                    const gchar     *name,
-                    gpointer         user_data)
+client_vanished (GDBusConnection *connection,
+                 const gchar     *name,
+                 gpointer         user_data)
 {
   PpdApp *data = user_data;
+  PpdClient *client;
+  GList *cookies, *l;
+
+  client = g_hash_table_lookup (data->clients, name);
+  if (!client)
+    return;
+
+  cookies = g_hash_table_get_keys (client->holds);
+  for (l = cookies; l != NULL; l = l->next) {
+    guint cookie = GPOINTER_TO_UINT (l->data);
+    g_debug ("Holder %s with cookie %u disappeared, removing profile hold", name, cookie);
+    release_profile_hold (data, cookie);
+  }
+  g_list_free (cookies);
+
+  g_debug ("Client %s vanished, forgetting its authorizations", name);
+  g_hash_table_remove (data->clients, name);
+}
+
+static PpdClient *
+client_new (PpdApp     *data,
+            const char *name)
+{
+  PpdClient *client;
+
+  client = g_new0 (PpdClient, 1);
+  client->name = g_strdup (name);
+  client->authorizations = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  client->holds = g_hash_table_new (g_direct_hash, g_direct_equal);
+  client->hold_tokens = data->settings->hold_rate_burst;
+  client->hold_tokens_time = g_get_monotonic_time ();
+  g_hash_table_insert (data->clients, client->name, client);
+
+  return client;
+}
+
+static PpdClient *
+get_client (PpdApp     *data,
+            const char *name)
+{
+  PpdClient *client;
+
+  client = g_hash_table_lookup (data->clients, name);
+  if (client)
+    return client;
+
+  client = client_new (data, name);
+  client->watch_id = g_bus_watch_name_on_connection (data->connection, name,
+                                                     G_BUS_NAME_WATCHER_FLAGS_NONE, NULL,
+                                                     client_vanished, data, NULL);
+
+  return client;
+}
+
+static const char *
+get_requester (GDBusConnection *connection,
+               const char      *sender)
+{
+  if (sender != NULL)
+    return sender;
+
+  /* Peer-to-peer connections have no bus name, use the one we made up */
+  return g_object_get_data (G_OBJECT (connection), "ppd-peer-name");
+}
+
+static gboolean
+auth_cache_lookup (PpdApp     *data,
+                   const char *sender,
+                   const char *action)
+{
+  PpdClient *client;
+  gint64 *expiry;
+
+  client = g_hash_table_lookup (data->clients, sender);
+  if (!client)
+    return FALSE;
+
+  expiry = g_hash_table_lookup (client->authorizations, action);
+  if (!expiry)
+    return FALSE;
+
+  if (*expiry < g_get_monotonic_time ()) {
+    g_hash_table_remove (client->authorizations, action);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+auth_cache_insert (PpdApp     *data,
+                   const char *sender,
+                   const char *action)
+{
+  PpdClient *client = get_client (data, sender);
+  gint64 *expiry = g_new (gint64, 1);
+
+  *expiry = g_get_monotonic_time () + AUTH_CACHE_TTL_USEC;
+  g_hash_table_replace (client->authorizations, g_strdup (action), expiry);
+}
+
+static void
+auth_cache_clear (PpdApp *data)
+{
   GHashTableIter iter;
-  gpointer key, value;
-  GPtrArray *cookies;
-  guint i;
+  gpointer value;
 
-  cookies = g_ptr_array_new ();
-  g_hash_table_iter_init (&iter, data->profile_holds);
-  while (g_hash_table_iter_next (&iter, &key, (gpointer *) &value)) {
-    guint cookie = GPOINTER_TO_UINT (key);
-    ProfileHold *hold = value;
+  g_hash_table_iter_init (&iter, data->clients);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    PpdClient *client = value;
+    g_hash_table_remove_all (client->authorizations);
+  }
+}
 
-    if (g_strcmp0 (hold->requester, name) != 0)
-      continue;
+static void
+polkit_authority_changed_cb (PolkitAuthority *authority,
+                             gpointer         user_data)
+{
+  PpdApp *data = user_data;
+  g_auto(PpdWatchdogScope) scope = ppd_watchdog_enter ("signal", "polkit-changed");
+
+  g_debug ("Polkit authority changed, flushing authorization cache");
+  auth_cache_clear (data);
+}
+
+static void dispatch_pending_calls (PpdApp *data);
+
+static void
+polkit_authority_ready_cb (GObject      *source_object,
+                           GAsyncResult *res,
+                           gpointer      user_data)
+{
+  PpdApp *data = user_data;
+  g_autoptr(GError) error = NULL;
+
+  data->auth = polkit_authority_get_finish (res, &error);
+  if (data->auth)
+    data->auth_changed_id = g_signal_connect (data->auth, "changed",
+                                              G_CALLBACK (polkit_authority_changed_cb), data);
+  else
+    g_warning ("Could not connect to polkit, authorizations will be denied: %s", error->message);
+
+  startup_phase_done (data, data->auth_requested, "polkit");
+  data->auth_requested = 0;
+
+  dispatch_pending_calls (data);
+  startup_check_ready (data);
+}
+
+static gboolean
+client_consume_hold_token (PpdApp      *data,
+                           const char  *sender,
+                           GError     **error)
+{
+  PpdSettings *options = data->settings;
+  PpdClient *client;
+  gint64 now;
 
-    g_debug ("Holder %s with cookie %u disappeared, adding to list", name, cookie);
-    g_ptr_array_add (cookies, GUINT_TO_POINTER (cookie));
+  if (options->hold_rate_limit <= 0)
+    return TRUE;
+
+  client = get_client (data, sender);
+  now = g_get_monotonic_time ();
+  client->hold_tokens += options->hold_rate_limit * (now - client->hold_tokens_time) / G_USEC_PER_SEC;
+  client->hold_tokens = MIN (client->hold_tokens, options->hold_rate_burst);
+  client->hold_tokens_time = now;
+
+  if (client->hold_tokens < 1) {
+    g_debug ("Client %s exceeded the hold rate limit", sender);
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_LIMITS_EXCEEDED,
+                 "Too many profile hold requests, limit is %g per second",
+                 options->hold_rate_limit);
+    return FALSE;
   }
 
-  for (i = 0; i < cookies->len; i++) {
-    guint cookie = GPOINTER_TO_UINT (cookies->pdata[i]);
-    g_debug ("Removing profile hold for cookie %u", cookie);
-    release_profile_hold (data, cookie);
+  client->hold_tokens -= 1;
+  return TRUE;
+}
+
+static GVariant *
+get_client_hold_counts_variant (PpdApp *data)
+{
+  GVariantBuilder builder;
+  GHashTableIter iter;
+  gpointer value;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{su}"));
+  g_hash_table_iter_init (&iter, data->clients);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    PpdClient *client = value;
+
+    if (g_hash_table_size (client->holds) == 0)
+      continue;
+
+    g_variant_builder_add (&builder, "{su}", client->name, g_hash_table_size (client->holds));
   }
-  g_ptr_array_free (cookies, TRUE);
+
+  return g_variant_builder_end (&builder);
+}
+
+static guint
+next_hold_cookie (PpdApp *data)
+{
+  do {
+    data->last_cookie++;
+  } while (data->last_cookie == 0 ||
+           g_hash_table_contains (data->profile_holds, GUINT_TO_POINTER (data->last_cookie)));
+
+  return data->last_cookie;
 }
 
 static void
 hold_profile (PpdApp                *data,
+              const char            *sender,
               GVariant              *parameters,
               GDBusMethodInvocation *invocation)
 {
@@ -840,7 +1626,8 @@ hold_profile (PpdApp                *data,
   const char *application_id;
   PpdProfile profile;
   ProfileHold *hold;
-  guint watch_id;
+  PpdClient *client;
+  guint cookie;
   guint mask;
 
   g_variant_get (parameters, "(&s&s&s)", &profile_name, &reason, &application_id);
@@ -858,20 +1645,30 @@ hold_profile (PpdApp                *data,
     return;
   }
 
+  client = get_client (data, sender);
+  if (data->settings->max_holds_per_client > 0 &&
+      g_hash_table_size (client->holds) >= data->settings->max_holds_per_client) {
+    g_debug ("Client %s reached the maximum number of holds", client->name);
+    g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_LIMITS_EXCEEDED,
+                                           "Cannot hold more than %d profiles at once",
+                                           data->settings->max_holds_per_client);
+    return;
+  }
+
   hold = g_new0 (ProfileHold, 1);
   hold->profile = profile;
   hold->reason = g_strdup (reason);
   hold->application_id = g_strdup (application_id);
-  hold->requester = g_strdup (g_dbus_method_invocation_get_sender (invocation));
+  hold->requester = g_strdup (sender);
   hold->requester_iface = g_strdup (g_dbus_method_invocation_get_interface_name (invocation));
 
   g_debug ("%s (%s) requesting to hold profile '%s', reason: '%s'", application_id,
            hold->requester, profile_name, reason);
-  watch_id = g_bus_watch_name_on_connection (data->connection, hold->requester,
-                                             G_BUS_NAME_WATCHER_FLAGS_NONE, NULL,
-                                             holder_disappeared, data, NULL);
-  g_hash_table_insert (data->profile_holds, GUINT_TO_POINTER (watch_id), hold);
-  g_dbus_method_invocation_return_value (invocation, g_variant_new ("(u)", watch_id));
+  cookie = next_hold_cookie (data);
+  add_profile_hold (data, client, cookie, hold);
+  PPD_TRACE3 (hold_add, cookie, profile, application_id);
+  ppd_recorder_record (PPD_EVENT_HOLD, application_id, profile, cookie, 0, reason);
+  g_dbus_method_invocation_return_value (invocation, g_variant_new ("(u)", cookie));
   mask = PROP_ACTIVE_PROFILE_HOLDS;
 
   if (profile != data->active_profile) {
@@ -911,14 +1708,43 @@ check_action_permission (PpdApp                *data,
   g_autoptr(GError) local_error = NULL;
   g_autoptr(PolkitAuthorizationResult) result = NULL;
   g_autoptr(PolkitSubject) subject = NULL;
+  PpdClient *client;
+  gint64 start = g_get_monotonic_time ();
+  const char *action_name = action;
+
+  if (g_str_has_prefix (action_name, POWER_PROFILES_POLICY_NAMESPACE "."))
+    action_name += strlen (POWER_PROFILES_POLICY_NAMESPACE ".");
+
+  if (sender != NULL && auth_cache_lookup (data, sender, action)) {
+    ppd_stats_count (data->stats, "auth-cache-hits");
+    g_debug ("Authorization for '%s' by %s found in cache (hits: %" G_GUINT64_FORMAT
+             ", misses: %" G_GUINT64_FORMAT ")",
+             action, sender,
+             ppd_stats_get_count (data->stats, "auth-cache-hits"),
+             ppd_stats_get_count (data->stats, "auth-cache-misses"));
+    return TRUE;
+  }
+  ppd_stats_count (data->stats, "auth-cache-misses");
+
+  /* A synchronous check without an authority would connect to polkit again */
+  if (data->auth == NULL) {
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_ACCESS_DENIED,
+                 "Not Authorized: authorization is unavailable, could not connect to polkit");
+    return FALSE;
+  }
 
-  subject = polkit_system_bus_name_new (sender);
+  client = g_hash_table_lookup (data->clients, sender);
+  if (client && client->subject)
+    subject = g_object_ref (client->subject);
+  else
+    subject = polkit_system_bus_name_new (sender);
   result = polkit_authority_check_authorization_sync (data->auth,
                                                       subject,
                                                       action,
                                                       NULL,
                                                       POLKIT_CHECK_AUTHORIZATION_FLAGS_NONE,
                                                       NULL, &local_error);
+  ppd_stats_record (data->stats, "authorization", action_name, g_get_monotonic_time () - start);
   if (result == NULL ||
       !polkit_authorization_result_get_is_authorized (result))
     {
@@ -928,8 +1754,87 @@ check_action_permission (PpdApp                *data,
       return FALSE;
     }
 
+  if (sender != NULL)
+    auth_cache_insert (data, sender, action);
+
+  return TRUE;
+
+}
+
+static gboolean
+daemon_is_idle (PpdApp *data)
+{
+  if (!data->was_started)
+    return FALSE;
+  if (g_hash_table_size (data->profile_holds) != 0)
+    return FALSE;
+  if (config_writes_pending (data))
+    return FALSE;
+  /* Drivers or actions need upower or logind events */
+  if (data->cancellable != NULL || data->logind_sleep_signal_id != 0)
+    return FALSE;
+  /* Drivers waiting for their hardware to appear */
+  if (data->probed_drivers->len != 0)
+    return FALSE;
+  /* Peers could not reconnect to activate us again */
+  if (data->peer_server != NULL)
+    return FALSE;
   return TRUE;
+}
+
+static void
+idle_exit (PpdApp *data)
+{
+  /* New requests will start a new instance through D-Bus activation */
+  g_clear_handle_id (&data->name_id, g_bus_unown_name);
+  g_clear_handle_id (&data->legacy_name_id, g_bus_unown_name);
+
+  /* The next instance finds the profile still applied by querying the drivers */
+  save_configuration (data);
+  flush_configuration (data);
+
+  g_main_loop_quit (data->main_loop);
+}
+
+static gboolean
+idle_timeout_cb (gpointer user_data)
+{
+  PpdApp *data = user_data;
+
+  if (!daemon_is_idle (data)) {
+    g_debug ("Daemon is busy, not exiting on idle");
+    return G_SOURCE_CONTINUE;
+  }
+
+  g_info ("Exiting after %d seconds of inactivity", data->debug_options->idle_exit_timeout);
+  data->idle_exit_id = 0;
+  idle_exit (data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+reset_idle_timeout (PpdApp *data)
+{
+  if (data->debug_options->idle_exit_timeout <= 0)
+    return;
+
+  g_clear_handle_id (&data->idle_exit_id, g_source_remove);
+  data->idle_exit_id = ppd_watchdog_timeout_add_seconds (data->debug_options->idle_exit_timeout,
+                                                         "idle-exit", idle_timeout_cb, data);
+}
+
+static void
+note_legacy_usage (PpdApp      *data,
+                   const gchar *interface_name,
+                   const gchar *sender)
+{
+  if (data->legacy_seen ||
+      !g_str_equal (interface_name, POWER_PROFILES_LEGACY_IFACE_NAME))
+    return;
 
+  g_debug ("Client %s uses the legacy interface, emitting its signals from now on", sender);
+  data->legacy_seen = TRUE;
 }
 
 static GVariant *
@@ -942,9 +1847,14 @@ handle_get_property (GDBusConnection *connection,
                      gpointer         user_data)
 {
   PpdApp *data = user_data;
+  g_auto(PpdWatchdogScope) scope = ppd_watchdog_enter ("get", property_name);
 
   g_return_val_if_fail (data->connection, NULL);
 
+  sender = get_requester (connection, sender);
+  note_legacy_usage (data, interface_name, sender);
+  reset_idle_timeout (data);
+
   if (g_strcmp0 (property_name, "ActiveProfile") == 0)
     return g_variant_new_string (get_active_profile (data));
   if (g_strcmp0 (property_name, "PerformanceInhibited") == 0)
@@ -966,25 +1876,70 @@ handle_get_property (GDBusConnection *connection,
     return get_profile_holds_variant (data);
   if (g_strcmp0 (property_name, "Version") == 0)
     return g_variant_new_string (VERSION);
+  if (g_str_equal (property_name, "StartupTimings") &&
+      g_str_equal (interface_name, POWER_PROFILES_IFACE_NAME))
+    return get_startup_timings_variant (data);
   g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
                "Invalid property'%s'", property_name);
   return NULL;
 }
 
-static gboolean
-handle_set_property (GDBusConnection  *connection,
-                     const gchar      *sender,
-                     const gchar      *object_path,
-                     const gchar      *interface_name,
-                     const gchar      *property_name,
-                     GVariant         *value,
-                     GError          **error,
-                     gpointer          user_data)
+static GVariant *
+get_all_dbus_properties (PpdApp           *data,
+                         GDBusConnection  *connection,
+                         const gchar      *sender,
+                         const gchar      *object_path,
+                         const gchar      *interface_name,
+                         GError          **error)
 {
-  PpdApp *data = user_data;
+  GDBusInterfaceInfo *info = NULL;
+  GVariantBuilder builder;
+
+  if (g_str_equal (interface_name, POWER_PROFILES_IFACE_NAME))
+    info = data->interface_info;
+  else if (g_str_equal (interface_name, POWER_PROFILES_LEGACY_IFACE_NAME))
+    info = data->legacy_interface_info;
+  if (info == NULL) {
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_INTERFACE,
+                 "Unknown interface %s", interface_name);
+    return NULL;
+  }
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+  for (guint i = 0; info->properties && info->properties[i]; i++) {
+    GDBusPropertyInfo *property = info->properties[i];
+    GVariant *value;
+
+    if (!(property->flags & G_DBUS_PROPERTY_INFO_FLAGS_READABLE))
+      continue;
+
+    value = handle_get_property (connection, sender, object_path, interface_name,
+                                 property->name, error, data);
+    if (value == NULL) {
+      g_variant_builder_clear (&builder);
+      return NULL;
+    }
+    g_variant_builder_add (&builder, "{sv}", property->name, value);
+  }
+
+  return g_variant_builder_end (&builder);
+}
 
+static gboolean
+set_dbus_property (PpdApp           *data,
+                   GDBusConnection  *connection,
+                   const gchar      *sender,
+                   const gchar      *interface_name,
+                   const gchar      *property_name,
+                   GVariant         *value,
+                   GError          **error)
+{
   g_return_val_if_fail (data->connection, FALSE);
 
+  sender = get_requester (connection, sender);
+  note_legacy_usage (data, interface_name, sender);
+  reset_idle_timeout (data);
+
   if (g_str_equal (property_name, "ActiveProfile")) {
     const char *profile;
 
@@ -1011,135 +1966,810 @@ handle_set_property (GDBusConnection  *connection,
   return FALSE;
 }
 
-static gboolean set_action_enabled (PpdApp                *data,
-                                    GVariant              *parameters,
-                                    GError                **error)
+static PpdAction *
+get_action (PpdApp     *data,
+            const char *action_name)
 {
-  const char *action_name;
-  gboolean active;
-
-  g_variant_get (parameters, "(&sb)", &action_name, &active);
-
   for (guint i = 0; i < data->actions->len; i++) {
     PpdAction *action = g_ptr_array_index (data->actions, i);
 
-    if (g_strcmp0 (ppd_action_get_action_name (action), action_name) == 0) {
-      g_key_file_set_boolean (data->config, "Actions", action_name, active);
-      restart_profile_drivers_for_default_app ();
-      return TRUE;
-    }
+    if (g_strcmp0 (ppd_action_get_action_name (action), action_name) == 0)
+      return action;
   }
-  g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
-               "No such action '%s'", action_name);
-  return FALSE;
+
+  return NULL;
 }
 
 static void
-handle_method_call (GDBusConnection       *connection,
-                    const gchar           *sender,
-                    const gchar           *object_path,
-                    const gchar           *interface_name,
-                    const gchar           *method_name,
-                    GVariant              *parameters,
-                    GDBusMethodInvocation *invocation,
-                    gpointer               user_data)
+refresh_action (PpdApp    *data,
+                PpdAction *action)
 {
-  PpdApp *data = user_data;
-  g_return_if_fail (data->connection);
+  const char *action_name = ppd_action_get_action_name (action);
+  g_autoptr(GVariant) percentage = NULL;
+  g_autoptr(GError) error = NULL;
 
-  if (!g_str_equal (interface_name, POWER_PROFILES_IFACE_NAME) &&
-      !g_str_equal (interface_name, POWER_PROFILES_LEGACY_IFACE_NAME)) {
-    g_dbus_method_invocation_return_error (invocation,G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_INTERFACE,
-                                           "Unknown interface %s", interface_name);
+  if (action_blocked (data, action)) {
+    if (ppd_action_get_active (action)) {
+      ppd_action_set_active (action, FALSE);
+      g_info ("Action '%s' disabled", action_name);
+    }
     return;
   }
 
-  if (g_strcmp0 (method_name, "HoldProfile") == 0) {
-    g_autoptr(GError) local_error = NULL;
-    if (!check_action_permission (data,
-                                  g_dbus_method_invocation_get_sender (invocation),
-                                  POWER_PROFILES_POLICY_NAMESPACE ".hold-profile",
-                                  &local_error)) {
-      g_dbus_method_invocation_return_gerror (invocation, local_error);
-      return;
-    }
-    hold_profile (data, parameters, invocation);
-  } else if (g_strcmp0 (method_name, "ReleaseProfile") == 0) {
-    release_profile (data, parameters, invocation);
-  } else if (g_strcmp0 (method_name, "SetActionEnabled") == 0) {
-    g_autoptr(GError) local_error = NULL;
+  if (ppd_action_get_active (action))
+    return;
 
-    if (g_str_equal (interface_name, POWER_PROFILES_LEGACY_IFACE_NAME)) {
-      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
-                                             "Method %s is not available in interface %s", method_name,
-                                             interface_name);
-      return;
-    }
+  if (ppd_action_probe (action) != PPD_PROBE_RESULT_SUCCESS) {
+    g_debug ("probe () failed for action '%s', not enabling it", action_name);
+    return;
+  }
 
-    if (!check_action_permission (data,
-                                  g_dbus_method_invocation_get_sender (invocation),
-                                  POWER_PROFILES_POLICY_NAMESPACE ".configure-action",
-                                  &local_error)) {
-      g_dbus_method_invocation_return_gerror (invocation, local_error);
-      return;
-    }
+  ppd_action_set_active (action, TRUE);
+  g_info ("Action '%s' enabled", action_name);
 
-    if (!set_action_enabled (data, parameters, &local_error)) {
-      g_dbus_method_invocation_return_gerror (invocation, local_error);
-      return;
-    }
-    g_dbus_method_invocation_return_value (invocation, NULL);
-  } else {
-      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
-                                             "No such method %s in interface %s", interface_name,
-                                              method_name);
+  /* Bring the action up to date with the current state */
+  if (!ppd_action_activate_profile (action, data->active_profile, &error)) {
+    g_warning ("Failed to activate action '%s' to profile %s: %s",
+               action_name, ppd_profile_to_str (data->active_profile), error->message);
+    g_clear_error (&error);
   }
-}
 
+  if (data->power_changed_reason != PPD_POWER_CHANGED_REASON_UNKNOWN &&
+      !ppd_action_power_changed (action, data->power_changed_reason, &error)) {
+    g_warning ("failed to update action %s: %s", action_name, error->message);
+    g_clear_error (&error);
+  }
 
-static const GDBusInterfaceVTable interface_vtable =
-{
-  handle_method_call,
-  handle_get_property,
-  handle_set_property
-};
+  if (data->upower_display_proxy)
+    percentage = g_dbus_proxy_get_cached_property (data->upower_display_proxy, "Percentage");
+  if (percentage &&
+      !ppd_action_battery_changed (action, g_variant_get_double (percentage), &error))
+    g_warning ("failed to update action %s: %s", action_name, error->message);
+}
 
-typedef struct {
+static void
+update_action_enabled (PpdApp    *data,
+                       PpdAction *action,
+                       gboolean   enabled)
+{
+  g_key_file_set_boolean (data->config, "Actions", ppd_action_get_action_name (action), enabled);
+  refresh_action (data, action);
+}
+
+static gboolean set_action_enabled (PpdApp                *data,
+                                    GVariant              *parameters,
+                                    GError                **error)
+{
+  const char *action_name;
+  PpdAction *action;
+  gboolean active;
+
+  g_variant_get (parameters, "(&sb)", &action_name, &active);
+
+  action = get_action (data, action_name);
+  if (action == NULL) {
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                 "No such action '%s'", action_name);
+    return FALSE;
+  }
+
+  update_action_enabled (data, action, active);
+  send_dbus_event (data, PROP_ACTIONS);
+  save_configuration (data);
+
+  return TRUE;
+}
+
+/* Each setting needs the same authorization as when changed on its own */
+static gboolean
+check_configuration_permissions (PpdApp      *data,
+                                 const char  *sender,
+                                 GVariant    *changes,
+                                 GError     **error)
+{
+  static const struct {
+    const char *key;
+    const char *action;
+  } key_actions[] = {
+    { "ActiveProfile", POWER_PROFILES_POLICY_NAMESPACE ".switch-profile" },
+    { "BatteryAware", POWER_PROFILES_POLICY_NAMESPACE ".configure-battery-aware" },
+    { "ActionsEnabled", POWER_PROFILES_POLICY_NAMESPACE ".configure-action" },
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS (key_actions); i++) {
+    g_autoptr(GVariant) value = g_variant_lookup_value (changes, key_actions[i].key, NULL);
+
+    if (value != NULL &&
+        !check_action_permission (data, sender, key_actions[i].action, error))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+apply_configuration_changes (PpdApp    *data,
+                             GVariant  *changes,
+                             GError   **error)
+{
+  g_autoptr(GVariant) actions_enabled = NULL;
+  PpdProfile target_profile = PPD_PROFILE_UNSET;
+  gboolean battery_support = data->battery_support;
+  GVariantIter iter;
+
+  /* Validate everything first, so that nothing is applied on error */
+  g_variant_iter_init (&iter, changes);
+  while (TRUE) {
+    g_autoptr(GVariant) value = NULL;
+    const char *key;
+
+    if (!g_variant_iter_next (&iter, "{&sv}", &key, &value))
+      break;
+
+    if (g_str_equal (key, "ActiveProfile") &&
+        g_variant_is_of_type (value, G_VARIANT_TYPE_STRING)) {
+      const char *profile = g_variant_get_string (value, NULL);
+
+      target_profile = ppd_profile_from_str (profile);
+      if (target_profile == PPD_PROFILE_UNSET) {
+        g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                     "Invalid profile name '%s'", profile);
+        return FALSE;
+      }
+      if (!get_profile_available (data, target_profile)) {
+        g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                     "Cannot switch to unavailable profile '%s'", profile);
+        return FALSE;
+      }
+    } else if (g_str_equal (key, "BatteryAware") &&
+               g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN)) {
+      battery_support = g_variant_get_boolean (value);
+    } else if (g_str_equal (key, "ActionsEnabled") &&
+               g_variant_is_of_type (value, G_VARIANT_TYPE ("a{sb}"))) {
+      GVariantIter actions_iter;
+      const char *action_name;
+      gboolean enabled;
+
+      g_variant_iter_init (&actions_iter, value);
+      while (g_variant_iter_next (&actions_iter, "{&sb}", &action_name, &enabled)) {
+        if (get_action (data, action_name) == NULL) {
+          g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                       "No such action '%s'", action_name);
+          return FALSE;
+        }
+      }
+      g_clear_pointer (&actions_enabled, g_variant_unref);
+      actions_enabled = g_steal_pointer (&value);
+    } else {
+      g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                   "Invalid configuration key '%s' of type '%s'",
+                   key, g_variant_get_type_string (value));
+      return FALSE;
+    }
+  }
+
+  if (battery_support && !data->battery_support && data->debug_options->disable_upower) {
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED,
+                 "upower integration is disabled");
+    return FALSE;
+  }
+
+  /* Switching profiles is the only change that can still fail, as the
+   * drivers might reject it, so it goes first and nothing else is applied
+   * if it does. The others cannot fail once validated. */
+  if (target_profile != PPD_PROFILE_UNSET &&
+      !set_active_profile (data, ppd_profile_to_str (target_profile), error))
+    return FALSE;
+
+  if (battery_support != data->battery_support &&
+      !set_battery_support (data, battery_support, error))
+    g_return_val_if_reached (FALSE);
+
+  if (actions_enabled) {
+    const char *action_name;
+    gboolean enabled;
+
+    g_variant_iter_init (&iter, actions_enabled);
+    while (g_variant_iter_next (&iter, "{&sb}", &action_name, &enabled))
+      update_action_enabled (data, get_action (data, action_name), enabled);
+    send_dbus_event (data, PROP_ACTIONS);
+  }
+
+  save_configuration (data);
+
+  return TRUE;
+}
+
+static void
+dispatch_method_call (PpdApp                *data,
+                      GDBusConnection       *connection,
+                      const gchar           *sender,
+                      const gchar           *interface_name,
+                      const gchar           *method_name,
+                      GVariant              *parameters,
+                      GDBusMethodInvocation *invocation)
+{
+  if (g_str_equal (interface_name, "org.freedesktop.DBus.Properties")) {
+    const char *object_path = g_dbus_method_invocation_get_object_path (invocation);
+    g_autoptr(GVariant) value = NULL;
+    g_autoptr(GError) local_error = NULL;
+    const char *property_iface;
+    const char *property_name;
+
+    /* GDBus checked that the interface and property exist, see interface_vtable */
+    if (g_str_equal (method_name, "Get")) {
+      g_variant_get (parameters, "(&s&s)", &property_iface, &property_name);
+      value = handle_get_property (connection, sender, object_path, property_iface,
+                                   property_name, &local_error, data);
+      if (value == NULL) {
+        g_dbus_method_invocation_return_gerror (invocation, local_error);
+        return;
+      }
+      g_dbus_method_invocation_return_value (invocation, g_variant_new ("(v)", value));
+      return;
+    }
+
+    if (g_str_equal (method_name, "GetAll")) {
+      g_variant_get (parameters, "(&s)", &property_iface);
+      value = get_all_dbus_properties (data, connection, sender, object_path,
+                                       property_iface, &local_error);
+      if (value == NULL) {
+        g_dbus_method_invocation_return_gerror (invocation, local_error);
+        return;
+      }
+      g_dbus_method_invocation_return_value (invocation,
+                                             g_variant_new_tuple (&value, 1));
+      return;
+    }
+
+    g_variant_get (parameters, "(&s&sv)", &property_iface, &property_name, &value);
+    if (!set_dbus_property (data, connection, sender, property_iface, property_name,
+                            value, &local_error)) {
+      g_dbus_method_invocation_return_gerror (invocation, local_error);
+      return;
+    }
+    g_dbus_method_invocation_return_value (invocation, NULL);
+    return;
+  }
+
+  if (!g_str_equal (interface_name, POWER_PROFILES_IFACE_NAME) &&
+      !g_str_equal (interface_name, POWER_PROFILES_LEGACY_IFACE_NAME)) {
+    g_dbus_method_invocation_return_error (invocation,G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_INTERFACE,
+                                           "Unknown interface %s", interface_name);
+    return;
+  }
+
+  sender = get_requester (connection, sender);
+  note_legacy_usage (data, interface_name, sender);
+  reset_idle_timeout (data);
+
+  if (g_strcmp0 (method_name, "HoldProfile") == 0) {
+    g_autoptr(GError) local_error = NULL;
+    if (!client_consume_hold_token (data, sender, &local_error)) {
+      g_dbus_method_invocation_return_gerror (invocation, local_error);
+      return;
+    }
+    if (!check_action_permission (data,
+                                  sender,
+                                  POWER_PROFILES_POLICY_NAMESPACE ".hold-profile",
+                                  &local_error)) {
+      g_dbus_method_invocation_return_gerror (invocation, local_error);
+      return;
+    }
+    hold_profile (data, sender, parameters, invocation);
+  } else if (g_strcmp0 (method_name, "ReleaseProfile") == 0) {
+    /* Not rate limited, so that clients over the limit can give holds back */
+    release_profile (data, parameters, invocation);
+  } else if (g_strcmp0 (method_name, "GetHoldCounts") == 0) {
+    g_autoptr(GError) local_error = NULL;
+
+    if (g_str_equal (interface_name, POWER_PROFILES_LEGACY_IFACE_NAME)) {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+                                             "Method %s is not available in interface %s", method_name,
+                                             interface_name);
+      return;
+    }
+    /* This lists the bus names of every client holding a profile */
+    if (!check_action_permission (data,
+                                  sender,
+                                  POWER_PROFILES_POLICY_NAMESPACE ".get-hold-counts",
+                                  &local_error)) {
+      g_dbus_method_invocation_return_gerror (invocation, local_error);
+      return;
+    }
+    g_dbus_method_invocation_return_value (invocation,
+                                           g_variant_new ("(@a{su})",
+                                                          get_client_hold_counts_variant (data)));
+  } else if (g_strcmp0 (method_name, "GetStatistics") == 0) {
+    if (g_str_equal (interface_name, POWER_PROFILES_LEGACY_IFACE_NAME)) {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+                                             "Method %s is not available in interface %s", method_name,
+                                             interface_name);
+      return;
+    }
+    g_dbus_method_invocation_return_value (invocation,
+                                           g_variant_new ("(@a{sv})",
+                                                          get_statistics_variant (data)));
+  } else if (g_strcmp0 (method_name, "GetEnergy") == 0) {
+    if (g_str_equal (interface_name, POWER_PROFILES_LEGACY_IFACE_NAME)) {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+                                             "Method %s is not available in interface %s", method_name,
+                                             interface_name);
+      return;
+    }
+    g_dbus_method_invocation_return_value (invocation,
+                                           g_variant_new ("(@a{sv})",
+                                                          ppd_energy_get_variant (data->energy)));
+  } else if (g_strcmp0 (method_name, "DumpEvents") == 0) {
+    if (g_str_equal (interface_name, POWER_PROFILES_LEGACY_IFACE_NAME)) {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+                                             "Method %s is not available in interface %s", method_name,
+                                             interface_name);
+      return;
+    }
+    g_dbus_method_invocation_return_value (invocation,
+                                           g_variant_new ("(@aa{sv})",
+                                                          ppd_recorder_get_variant ()));
+  } else if (g_strcmp0 (method_name, "SetActionEnabled") == 0) {
+    g_autoptr(GError) local_error = NULL;
+
+    if (g_str_equal (interface_name, POWER_PROFILES_LEGACY_IFACE_NAME)) {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+                                             "Method %s is not available in interface %s", method_name,
+                                             interface_name);
+      return;
+    }
+
+    if (!check_action_permission (data,
+                                  sender,
+                                  POWER_PROFILES_POLICY_NAMESPACE ".configure-action",
+                                  &local_error)) {
+      g_dbus_method_invocation_return_gerror (invocation, local_error);
+      return;
+    }
+
+    if (!set_action_enabled (data, parameters, &local_error)) {
+      g_dbus_method_invocation_return_gerror (invocation, local_error);
+      return;
+    }
+    g_dbus_method_invocation_return_value (invocation, NULL);
+  } else if (g_strcmp0 (method_name, "ApplyConfiguration") == 0) {
+    g_autoptr(GVariant) changes = NULL;
+    g_autoptr(GError) local_error = NULL;
+    gboolean ret;
+
+    if (g_str_equal (interface_name, POWER_PROFILES_LEGACY_IFACE_NAME)) {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+                                             "Method %s is not available in interface %s", method_name,
+                                             interface_name);
+      return;
+    }
+
+    g_variant_get (parameters, "(@a{sv})", &changes);
+
+    if (!check_configuration_permissions (data, sender, changes, &local_error)) {
+      g_dbus_method_invocation_return_gerror (invocation, local_error);
+      return;
+    }
+
+    freeze_dbus_events (data);
+    ret = apply_configuration_changes (data, changes, &local_error);
+    thaw_dbus_events (data);
+
+    if (!ret) {
+      g_dbus_method_invocation_return_gerror (invocation, local_error);
+      return;
+    }
+    g_dbus_method_invocation_return_value (invocation, NULL);
+  } else {
+      g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+                                             "No such method %s in interface %s", interface_name,
+                                              method_name);
+  }
+}
+
+static void
+handle_method_call (GDBusConnection       *connection,
+                    const gchar           *sender,
+                    const gchar           *object_path,
+                    const gchar           *interface_name,
+                    const gchar           *method_name,
+                    GVariant              *parameters,
+                    GDBusMethodInvocation *invocation,
+                    gpointer               user_data)
+{
+  PpdApp *data = user_data;
+  g_auto(PpdWatchdogScope) scope = ppd_watchdog_enter ("method", method_name);
+  g_autofree char *request = NULL;
+  gint64 *received;
+  gint64 received_time;
+
+  g_return_if_fail (data->connection);
+
+  /* Queued calls keep the time they first arrived */
+  received = g_object_get_data (G_OBJECT (invocation), "ppd-received-time");
+  if (received == NULL) {
+    received = g_new (gint64, 1);
+    *received = g_get_monotonic_time ();
+    g_object_set_data_full (G_OBJECT (invocation), "ppd-received-time", received, g_free);
+  }
+
+  /* Polkit or the drivers are not set up yet, answer once they are */
+  if (!data->was_started || data->auth_requested != 0) {
+    g_debug ("Queuing early call to %s.%s", interface_name, method_name);
+    g_queue_push_tail (data->pending_calls, invocation);
+    return;
+  }
+
+  /* The invocation is gone once it was answered */
+  received_time = *received;
+  if (g_str_equal (interface_name, "org.freedesktop.DBus.Properties") &&
+      !g_str_equal (method_name, "GetAll")) {
+    const char *property_name;
+
+    g_variant_get_child (parameters, 1, "&s", &property_name);
+    request = g_strdup_printf ("%s %s", method_name, property_name);
+  } else {
+    request = g_strdup (method_name);
+  }
+
+  dispatch_method_call (data, connection, sender, interface_name, method_name,
+                        parameters, invocation);
+
+  ppd_stats_record (data->stats, "request", request, g_get_monotonic_time () - received_time);
+}
+
+
+static void
+dispatch_pending_calls (PpdApp *data)
+{
+  GDBusMethodInvocation *invocation;
+
+  if (!data->was_started || data->auth_requested != 0)
+    return;
+
+  while ((invocation = g_queue_pop_head (data->pending_calls)) != NULL) {
+    handle_method_call (g_dbus_method_invocation_get_connection (invocation),
+                        g_dbus_method_invocation_get_sender (invocation),
+                        g_dbus_method_invocation_get_object_path (invocation),
+                        g_dbus_method_invocation_get_interface_name (invocation),
+                        g_dbus_method_invocation_get_method_name (invocation),
+                        g_dbus_method_invocation_get_parameters (invocation),
+                        invocation,
+                        data);
+  }
+}
+
+/* Without property handlers, property reads and changes reach
+ * handle_method_call() and can be queued like method calls until the
+ * daemon is ready, instead of returning the defaults */
+static const GDBusInterfaceVTable interface_vtable =
+{
+  handle_method_call,
+  NULL,
+  NULL
+};
+
+typedef struct {
   PpdApp *app;
   GBusNameOwnerFlags flags;
   GDBusInterfaceInfo *interface;
   GDBusInterfaceInfo *legacy_interface;
 } PpdBusOwnData;
 
-static void
-ppd_bus_own_data_free (PpdBusOwnData *data)
-{
-  g_clear_pointer (&data->interface, g_dbus_interface_info_unref);
-  g_clear_pointer (&data->legacy_interface, g_dbus_interface_info_unref);
-  g_free (data);
+static void
+ppd_bus_own_data_free (PpdBusOwnData *data)
+{
+  g_clear_pointer (&data->interface, g_dbus_interface_info_unref);
+  g_clear_pointer (&data->legacy_interface, g_dbus_interface_info_unref);
+  g_free (data);
+}
+
+static void
+name_lost_handler (GDBusConnection *connection,
+                   const gchar     *name,
+                   gpointer         user_data)
+{
+  PpdBusOwnData *data = user_data;
+  PpdApp *app = data->app;
+
+  g_warning ("power-profiles-daemon is already running, or it cannot own its D-Bus name. Verify installation.");
+  if (!app->was_started)
+    app->ret = EXIT_FAILURE;
+
+  g_main_loop_quit (app->main_loop);
+}
+
+static void
+legacy_name_acquired_handler (GDBusConnection *connection,
+                              const gchar     *name,
+                              gpointer         user_data)
+{
+  g_debug ("Name '%s' acquired", name);
+}
+
+static void
+peer_connection_closed_cb (GDBusConnection *connection,
+                           gboolean         remote_peer_vanished,
+                           GError          *error,
+                           gpointer         user_data)
+{
+  PpdApp *data = user_data;
+  const char *name = g_object_get_data (G_OBJECT (connection), "ppd-peer-name");
+
+  g_debug ("Peer %s disconnected", name);
+  client_vanished (connection, name, data);
+  g_signal_handlers_disconnect_by_data (connection, data);
+  g_ptr_array_remove (data->peers, connection);
+}
+
+static gboolean
+peer_allow_mechanism_cb (GDBusAuthObserver *observer,
+                         const gchar       *mechanism,
+                         gpointer           user_data)
+{
+  /* Only trust the kernel-provided SO_PEERCRED credentials */
+  return g_strcmp0 (mechanism, "EXTERNAL") == 0;
+}
+
+/* The start time polkit uses to tell a process from a later one with
+ * the same PID, in clock ticks since boot, or 0 if it is gone */
+static guint64
+get_process_start_time (pid_t pid)
+{
+  g_autofree char *path = g_strdup_printf ("/proc/%d/stat", (int) pid);
+  g_autofree char *contents = NULL;
+  g_auto(GStrv) fields = NULL;
+  const char *end;
+  guint64 start_time = 0;
+
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    return 0;
+
+  /* The command name is in parentheses, and can contain anything */
+  end = strrchr (contents, ')');
+  if (end == NULL || end[1] != ' ')
+    return 0;
+
+  /* The start time is field 22, the state after the name is field 3 */
+  fields = g_strsplit (end + 2, " ", 21);
+  if (g_strv_length (fields) < 20)
+    return 0;
+  g_ascii_string_to_unsigned (fields[19], 10, 0, G_MAXUINT64, &start_time, NULL);
+
+  return start_time;
+}
+
+/* A pidfd for the process that connected, which cannot be recycled */
+static int
+get_peer_pidfd (GDBusConnection *connection)
+{
+#ifdef SO_PEERPIDFD
+  GIOStream *stream = g_dbus_connection_get_stream (connection);
+  socklen_t len = sizeof (int);
+  GSocket *socket;
+  int pidfd = -1;
+
+  if (!G_IS_SOCKET_CONNECTION (stream))
+    return -1;
+
+  socket = g_socket_connection_get_socket (G_SOCKET_CONNECTION (stream));
+  if (getsockopt (g_socket_get_fd (socket), SOL_SOCKET, SO_PEERPIDFD, &pidfd, &len) < 0) {
+    g_debug ("Could not get the peer pidfd: %s", g_strerror (errno));
+    return -1;
+  }
+
+  return pidfd;
+#else
+  return -1;
+#endif
+}
+
+static PolkitSubject *
+peer_subject_new (GDBusConnection *connection,
+                  pid_t            pid,
+                  uid_t            uid)
+{
+  PolkitSubject *subject;
+  guint64 start_time;
+  int pidfd;
+
+  pidfd = get_peer_pidfd (connection);
+#ifdef HAVE_POLKIT_PIDFD
+  if (pidfd >= 0) {
+    /* polkit keeps its own copy of the pidfd */
+    subject = polkit_unix_process_new_pidfd (pidfd, uid, NULL);
+    close (pidfd);
+    return subject;
+  }
+#endif
+  if (pidfd >= 0)
+    close (pidfd);
+
+  /* Without a start time polkit would look it up itself, on every check,
+   * and could then find another process that got the same PID */
+  start_time = get_process_start_time (pid);
+  if (start_time == 0)
+    return NULL;
+
+  return polkit_unix_process_new_for_owner (pid, start_time, uid);
+}
+
+static guint
+count_user_peers (PpdApp *data,
+                  uid_t   uid)
+{
+  guint count = 0;
+
+  for (guint i = 0; i < data->peers->len; i++) {
+    GObject *peer = g_ptr_array_index (data->peers, i);
+
+    if (GPOINTER_TO_UINT (g_object_get_data (peer, "ppd-peer-uid")) == uid)
+      count++;
+  }
+
+  return count;
+}
+
+static gboolean
+peer_new_connection_cb (GDBusServer     *server,
+                        GDBusConnection *connection,
+                        gpointer         user_data)
+{
+  PpdApp *data = user_data;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *name = NULL;
+  g_autoptr(PolkitSubject) subject = NULL;
+  GCredentials *credentials;
+  PpdClient *client;
+  pid_t pid;
+  uid_t uid;
+
+  credentials = g_dbus_connection_get_peer_credentials (connection);
+  if (credentials == NULL) {
+    g_debug ("Rejecting peer connection without credentials");
+    return FALSE;
+  }
+
+  uid = g_credentials_get_unix_user (credentials, &error);
+  if (uid == (uid_t) -1) {
+    g_debug ("Rejecting peer connection: %s", error->message);
+    return FALSE;
+  }
+
+  if (data->peers->len >= MAX_PEERS) {
+    g_debug ("Rejecting peer connection: too many peers");
+    return FALSE;
+  }
+  if (count_user_peers (data, uid) >= MAX_PEERS_PER_USER) {
+    g_debug ("Rejecting peer connection: too many peers for uid %d", (int) uid);
+    return FALSE;
+  }
+
+  pid = g_credentials_get_unix_pid (credentials, &error);
+  if (pid == -1) {
+    g_debug ("Rejecting peer connection: %s", error->message);
+    return FALSE;
+  }
+
+  subject = peer_subject_new (connection, pid, uid);
+  if (subject == NULL) {
+    g_debug ("Rejecting peer connection: process %d is gone", (int) pid);
+    return FALSE;
+  }
+
+  if (g_dbus_connection_register_object (connection,
+                                         POWER_PROFILES_DBUS_PATH,
+                                         data->peer_interface,
+                                         &interface_vtable,
+                                         data,
+                                         NULL,
+                                         &error) == 0) {
+    g_warning ("Failed to register object on peer connection: %s", error->message);
+    return FALSE;
+  }
+
+  name = g_strdup_printf ("peer-%u", ++data->last_peer_id);
+  g_debug ("Peer %s connected (pid %d, uid %d)", name, (int) pid, (int) uid);
+
+  client = client_new (data, name);
+  client->connection = connection;
+  client->subject = g_steal_pointer (&subject);
+
+  g_object_set_data_full (G_OBJECT (connection), "ppd-peer-name",
+                          g_steal_pointer (&name), g_free);
+  g_object_set_data (G_OBJECT (connection), "ppd-peer-uid", GUINT_TO_POINTER (uid));
+  g_signal_connect (connection, "closed",
+                    G_CALLBACK (peer_connection_closed_cb), data);
+  g_ptr_array_add (data->peers, g_object_ref (connection));
+
+  return TRUE;
+}
+
+/* Returns where to create the socket at @path, after making room for it */
+static char *
+prepare_socket_path (const char  *path,
+                     GError     **error)
+{
+  g_autofree char *socket_path = NULL;
+  g_autofree char *dirname = NULL;
+
+  if (g_getenv ("UMOCKDEV_DIR") != NULL)
+    socket_path = g_build_filename (g_getenv ("UMOCKDEV_DIR"), path, NULL);
+  else
+    socket_path = g_strdup (path);
+
+  dirname = g_path_get_dirname (socket_path);
+  if (g_mkdir_with_parents (dirname, 0755) < 0) {
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                 "Could not create '%s': %s", dirname, g_strerror (errno));
+    return NULL;
+  }
+  g_unlink (socket_path);
+
+  return g_steal_pointer (&socket_path);
+}
+
+static gboolean
+setup_peer_server (PpdApp              *data,
+                   GDBusInterfaceInfo  *interface,
+                   GError             **error)
+{
+  g_autoptr(GDBusAuthObserver) observer = NULL;
+  g_autofree char *escaped_path = NULL;
+  g_autofree char *address = NULL;
+  g_autofree char *guid = NULL;
+
+  data->peer_socket_path = prepare_socket_path (POWER_PROFILES_PEER_SOCKET_PATH, error);
+  if (data->peer_socket_path == NULL)
+    return FALSE;
+
+  escaped_path = g_dbus_address_escape_value (data->peer_socket_path);
+  address = g_strdup_printf ("unix:path=%s", escaped_path);
+  guid = g_dbus_generate_guid ();
+  observer = g_dbus_auth_observer_new ();
+  g_signal_connect (observer, "allow-mechanism",
+                    G_CALLBACK (peer_allow_mechanism_cb), NULL);
+
+  data->peer_server = g_dbus_server_new_sync (address,
+                                              G_DBUS_SERVER_FLAGS_NONE,
+                                              guid,
+                                              observer,
+                                              NULL,
+                                              error);
+  if (!data->peer_server)
+    return FALSE;
+
+  /* Access control is done through polkit, like on the system bus */
+  g_chmod (data->peer_socket_path, 0666);
+
+  data->peer_interface = g_dbus_interface_info_ref (interface);
+  g_signal_connect (data->peer_server, "new-connection",
+                    G_CALLBACK (peer_new_connection_cb), data);
+  g_dbus_server_start (data->peer_server);
+  g_debug ("Listening for peer connections on '%s'", data->peer_socket_path);
+
+  return TRUE;
 }
 
-static void
-name_lost_handler (GDBusConnection *connection,
-                   const gchar     *name,
-                   gpointer         user_data)
+static gboolean
+setup_metrics_server (PpdApp  *data,
+                      GError **error)
 {
-  PpdBusOwnData *data = user_data;
-  PpdApp *app = data->app;
+  data->metrics_path = prepare_socket_path (POWER_PROFILES_METRICS_PATH, error);
+  if (data->metrics_path == NULL)
+    return FALSE;
 
-  g_warning ("power-profiles-daemon is already running, or it cannot own its D-Bus name. Verify installation.");
-  if (!app->was_started)
-    app->ret = EXIT_FAILURE;
+  data->metrics = ppd_metrics_new (data->stats);
+  data->metrics_service = ppd_metrics_serve (data->metrics, data->metrics_path, error);
+  if (data->metrics_service == NULL)
+    return FALSE;
 
-  g_main_loop_quit (app->main_loop);
-}
+  /* Nothing secret, the same is readable on the bus */
+  g_chmod (data->metrics_path, 0666);
+  g_debug ("Serving metrics on '%s'", data->metrics_path);
 
-static void
-legacy_name_acquired_handler (GDBusConnection *connection,
-                              const gchar     *name,
-                              gpointer         user_data)
-{
-  g_debug ("Name '%s' acquired", name);
+  return TRUE;
 }
 
 static void
@@ -1157,6 +2787,20 @@ bus_acquired_handler (GDBusConnection *connection,
                                      NULL,
                                      NULL);
 
+  data->app->connection = g_object_ref (connection);
+
+  if (data->app->debug_options->peer_socket) {
+    g_autoptr(GError) error = NULL;
+
+    if (!setup_peer_server (data->app, data->interface, &error))
+      g_warning ("Failed to set up the peer socket: %s", error->message);
+  }
+
+  if (data->app->debug_options->disable_legacy_name) {
+    g_debug ("Legacy interface is disabled, not owning '%s'", POWER_PROFILES_LEGACY_DBUS_NAME);
+    return;
+  }
+
   g_dbus_connection_register_object (connection,
                                      POWER_PROFILES_LEGACY_DBUS_PATH,
                                      data->legacy_interface,
@@ -1172,8 +2816,6 @@ bus_acquired_handler (GDBusConnection *connection,
                                                             name_lost_handler,
                                                             data,
                                                             NULL);
-
-  data->app->connection = g_object_ref (connection);
 }
 
 static void
@@ -1205,6 +2847,7 @@ static void
 upower_battery_changed (PpdApp *data, gdouble level)
 {
   g_info ("Battery level changed to %f", level);
+  ppd_recorder_record (PPD_EVENT_BATTERY, NULL, PPD_PROFILE_UNSET, (gint64) level, 0, NULL);
 
   for (guint i = 0; i < data->actions->len; i++) {
     g_autoptr(GError) error = NULL;
@@ -1262,17 +2905,19 @@ upower_properties_changed (GDBusProxy *proxy,
                            PpdApp *data)
 {
   g_auto(GVariantDict) props_dict = G_VARIANT_DICT_INIT (changed_properties);
+  g_auto(PpdWatchdogScope) scope = ppd_watchdog_enter ("signal", "upower-changed");
   g_autoptr(GVariant) battery_val = NULL;
   g_autoptr(GVariant) percent_val = NULL;
 
   battery_val = g_variant_dict_lookup_value (&props_dict, "OnBattery",
                                              G_VARIANT_TYPE_BOOLEAN);
+  percent_val = g_variant_dict_lookup_value (&props_dict, "Percentage",
+                                             G_VARIANT_TYPE_DOUBLE);
+  PPD_TRACE2 (upower_event, battery_val != NULL, percent_val != NULL);
 
   if (battery_val)
     upower_source_update_from_value (data, battery_val);
 
-  percent_val = g_variant_dict_lookup_value (&props_dict, "Percentage",
-                                             G_VARIANT_TYPE_DOUBLE);
   if (percent_val)
     upower_battery_changed (data, g_variant_get_double (percent_val));
 }
@@ -1287,6 +2932,8 @@ upower_battery_set_power_changed_reason (PpdApp                *data,
   data->power_changed_reason = reason;
   g_info ("Power Changed because of reason %s",
           ppd_power_changed_reason_to_str (reason));
+  ppd_recorder_record (PPD_EVENT_POWER_SOURCE, ppd_power_changed_reason_to_str (reason),
+                       PPD_PROFILE_UNSET, 0, 0, NULL);
 
   for (guint i = 0; i < data->actions->len; i++) {
     g_autoptr(GError) error = NULL;
@@ -1356,8 +3003,11 @@ on_upower_proxy_cb (GObject *source_object,
   PpdApp *data = user_data;
   g_autoptr(GDBusProxy) upower_proxy = NULL;
   g_autoptr(GError) error = NULL;
+  gboolean needs_battery_state_monitor;
+  gboolean needs_battery_change_monitor;
 
   upower_proxy = g_dbus_proxy_new_finish (res, &error);
+  startup_upower_done (data);
 
   if (upower_proxy == NULL) {
     if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
@@ -1367,6 +3017,12 @@ on_upower_proxy_cb (GObject *source_object,
     return;
   }
 
+  get_battery_monitor_needs (data, &needs_battery_state_monitor, &needs_battery_change_monitor);
+  if (!needs_battery_state_monitor) {
+    g_debug ("Battery state monitor not required by any driver, dropping it");
+    return;
+  }
+
   g_return_if_fail (data->upower_proxy == NULL);
   data->upower_proxy = g_steal_pointer (&upower_proxy);
 
@@ -1393,8 +3049,11 @@ on_upower_display_proxy_cb (GObject *source_object,
   PpdApp *data = user_data;
   g_autoptr(GDBusProxy) proxy = NULL;
   g_autoptr(GError) error = NULL;
+  gboolean needs_battery_state_monitor;
+  gboolean needs_battery_change_monitor;
 
   proxy = g_dbus_proxy_new_finish (res, &error);
+  startup_upower_done (data);
 
   if (proxy == NULL) {
     if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
@@ -1404,6 +3063,12 @@ on_upower_display_proxy_cb (GObject *source_object,
     return;
   }
 
+  get_battery_monitor_needs (data, &needs_battery_state_monitor, &needs_battery_change_monitor);
+  if (!needs_battery_change_monitor) {
+    g_debug ("Battery change monitor not required by any driver, dropping it");
+    return;
+  }
+
   g_return_if_fail (data->upower_display_proxy == NULL);
   data->upower_display_proxy = g_steal_pointer (&proxy);
 
@@ -1432,6 +3097,7 @@ on_logind_prepare_for_sleep_cb (GDBusConnection *connection,
                                 gpointer         user_data)
 {
   PpdApp *data = user_data;
+  g_auto(PpdWatchdogScope) scope = ppd_watchdog_enter ("signal", "logind-sleep");
   gboolean start;
 
   g_variant_get (parameters, "(b)", &start);
@@ -1440,6 +3106,10 @@ on_logind_prepare_for_sleep_cb (GDBusConnection *connection,
     g_debug ("System preparing for suspend");
   else
     g_debug ("System woke up from suspend");
+  ppd_recorder_record (start ? PPD_EVENT_SUSPEND : PPD_EVENT_RESUME, NULL,
+                       PPD_PROFILE_UNSET, 0, 0, NULL);
+
+  ppd_energy_prepare_to_sleep (data->energy, start);
 
   if (PPD_IS_DRIVER_CPU (data->cpu_driver)) {
     g_autoptr(GError) error = NULL;
@@ -1463,129 +3133,497 @@ on_logind_prepare_for_sleep_cb (GDBusConnection *connection,
 }
 
 static gboolean
-has_required_drivers (PpdApp *data)
+has_required_drivers (PpdApp *data)
+{
+  if (!PPD_IS_DRIVER_CPU (data->cpu_driver) &&
+      !PPD_IS_DRIVER_PLATFORM (data->platform_driver))
+    return FALSE;
+
+  if (!get_profile_available (data, PPD_PROFILE_BALANCED | PPD_PROFILE_POWER_SAVER))
+    return FALSE;
+
+  return TRUE;
+}
+
+static void
+restart_profile_drivers (PpdApp *data)
+{
+  stop_profile_drivers (data);
+  start_profile_drivers (data);
+}
+
+static void
+driver_probe_request_cb (PpdDriver *driver,
+                         gpointer   user_data)
+{
+  PpdApp *data = user_data;
+  g_auto(PpdWatchdogScope) scope = ppd_watchdog_enter ("signal", "driver-probe-request");
+
+  restart_profile_drivers (data);
+}
+
+static void
+disconnect_array_objects_signals_by_data (GPtrArray *array,
+                                          void      *data)
+{
+  for (guint i = 0; i < array->len; ++i) {
+    GObject *object = g_ptr_array_index (array, i);
+
+    g_signal_handlers_disconnect_by_data (object, data);
+  }
+}
+
+static void
+maybe_disconnect_object_by_data (void *object,
+                                 void *data)
+{
+  if (!G_IS_OBJECT (object))
+    return;
+
+  g_signal_handlers_disconnect_by_data (object, data);
+}
+
+static void
+get_battery_monitor_needs (PpdApp   *data,
+                           gboolean *needs_battery_state_monitor,
+                           gboolean *needs_battery_change_monitor)
+{
+  PpdDriver *drivers[] = {
+    PPD_DRIVER (data->cpu_driver),
+    PPD_DRIVER (data->platform_driver),
+  };
+
+  *needs_battery_state_monitor = FALSE;
+  *needs_battery_change_monitor = FALSE;
+
+  for (guint i = 0; i < G_N_ELEMENTS (drivers); i++) {
+    if (drivers[i] == NULL)
+      continue;
+
+    if (PPD_DRIVER_GET_CLASS (drivers[i])->power_changed != NULL)
+      *needs_battery_state_monitor = TRUE;
+
+    if (PPD_DRIVER_GET_CLASS (drivers[i])->battery_changed != NULL)
+      *needs_battery_change_monitor = TRUE;
+  }
+
+  for (guint i = 0; i < data->actions->len; i++) {
+    PpdAction *action = g_ptr_array_index (data->actions, i);
+
+    if (PPD_ACTION_GET_CLASS (action)->power_changed != NULL)
+      *needs_battery_state_monitor = TRUE;
+
+    if (PPD_ACTION_GET_CLASS (action)->battery_changed != NULL)
+      *needs_battery_change_monitor = TRUE;
+  }
+}
+
+static void
+upower_monitor_start (PpdApp *data)
+{
+  gboolean needs_battery_state_monitor;
+  gboolean needs_battery_change_monitor;
+
+  if (!data->battery_support) {
+    g_debug ("upower is disabled, let's skip it");
+    return;
+  }
+
+  if (data->cancellable != NULL) {
+    g_debug ("upower is already monitored");
+    return;
+  }
+
+  get_battery_monitor_needs (data, &needs_battery_state_monitor, &needs_battery_change_monitor);
+  if (!needs_battery_state_monitor && !needs_battery_change_monitor) {
+    g_debug ("No battery state monitor required by any driver, let's skip it");
+    return;
+  }
+
+  upower_monitor_connect (data, needs_battery_state_monitor, needs_battery_change_monitor);
+}
+
+static void
+upower_monitor_connect (PpdApp   *data,
+                        gboolean  needs_battery_state_monitor,
+                        gboolean  needs_battery_change_monitor)
+{
+  data->cancellable = g_cancellable_new ();
+
+  /* Not ready until the proxies have their initial properties */
+  if (!data->ready) {
+    data->startup_mark = g_get_monotonic_time ();
+    data->startup_pending += needs_battery_state_monitor + needs_battery_change_monitor;
+  }
+
+  /* start watching for power changes */
+  if (needs_battery_state_monitor) {
+    g_debug ("Battery state monitor required, connecting to upower...");
+    g_dbus_proxy_new (data->connection,
+                      G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START |
+                      G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
+                      NULL,
+                      UPOWER_DBUS_NAME,
+                      UPOWER_DBUS_PATH,
+                      UPOWER_DBUS_INTERFACE,
+                      data->cancellable,
+                      on_upower_proxy_cb,
+                      data);
+  }
+
+  if (needs_battery_change_monitor) {
+    g_debug ("Battery change monitor required, connecting to upower...");
+    g_dbus_proxy_new (data->connection,
+                      G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START |
+                      G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
+                      NULL,
+                      UPOWER_DBUS_NAME,
+                      UPOWER_DBUS_DISPLAY_DEVICE_PATH,
+                      UPOWER_DBUS_DEVICE_INTERFACE,
+                      data->cancellable,
+                      on_upower_display_proxy_cb,
+                      data);
+  }
+}
+
+static void
+upower_monitor_stop (PpdApp *data)
+{
+  upower_battery_set_power_changed_reason (data, PPD_POWER_CHANGED_REASON_UNKNOWN);
+  g_cancellable_cancel (data->cancellable);
+  g_clear_signal_handler (&data->upower_watch_id, data->upower_proxy);
+  g_clear_signal_handler (&data->upower_properties_id, data->upower_proxy);
+  g_clear_signal_handler (&data->upower_display_watch_id, data->upower_display_proxy);
+  g_clear_signal_handler (&data->upower_display_properties_id, data->upower_display_proxy);
+  g_clear_object (&data->cancellable);
+  maybe_disconnect_object_by_data (data->upower_proxy, data);
+  g_clear_object (&data->upower_proxy);
+  maybe_disconnect_object_by_data (data->upower_display_proxy, data);
+  g_clear_object (&data->upower_display_proxy);
+}
+
+static void
+stop_profile_drivers (PpdApp *data)
+{
+  logind_monitor_stop (data);
+  upower_monitor_stop (data);
+  if (!data->preserve_holds)
+    release_all_profile_holds (data);
+  disconnect_array_objects_signals_by_data (data->probed_drivers, data);
+  g_ptr_array_set_size (data->probed_drivers, 0);
+  disconnect_array_objects_signals_by_data (data->actions, data);
+  g_ptr_array_set_size (data->actions, 0);
+  maybe_disconnect_object_by_data (data->cpu_driver, data);
+  g_clear_object (&data->cpu_driver);
+  maybe_disconnect_object_by_data (data->platform_driver, data);
+  g_clear_object (&data->platform_driver);
+}
+
+static gboolean
+action_blocked (PpdApp *app, PpdAction *action)
+{
+  const gchar *action_name = ppd_action_get_action_name (action);
+  g_autoptr(GError) error = NULL;
+  gboolean blocked;
+
+  if (g_strv_contains ((const gchar *const *) app->settings->blocked_actions, action_name)) {
+    g_debug ("Action '%s' is blocked by command line or administrator", action_name);
+    return TRUE;
+  }
+
+  blocked = !g_key_file_get_boolean (app->config, "Actions", action_name, &error);
+
+  /* if not in conffile, fallback to action opt-in */
+  if (error != NULL) {
+    blocked = ppd_action_get_optin (action);
+    g_debug ("Action '%s' is set %s by default", action_name, blocked ? "disabled" : "enabled");
+    return blocked;
+  }
+
+  g_debug ("Action '%s' is %s by configuration", action_name, blocked ? "disabled" : "enabled");
+  return blocked;
+}
+
+static gboolean
+driver_blocked (PpdApp *app, PpdDriver *driver)
+{
+  const gchar *driver_name = ppd_driver_get_driver_name (driver);
+  gboolean blocked;
+
+  blocked = g_strv_contains ((const gchar *const *) app->settings->blocked_drivers, driver_name);
+  if (blocked)
+    g_debug ("Driver '%s' is blocked", driver_name);
+  return blocked;
+}
+
+static GVariant *
+serialize_state (PpdApp *data)
+{
+  GVariantBuilder builder;
+  GVariantBuilder holds_builder;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&builder, "{sv}", "ActiveProfile",
+                         g_variant_new_string (ppd_profile_to_str (data->active_profile)));
+  g_variant_builder_add (&builder, "{sv}", "SelectedProfile",
+                         g_variant_new_string (ppd_profile_to_str (data->selected_profile)));
+  if (PPD_IS_DRIVER_CPU (data->cpu_driver))
+    g_variant_builder_add (&builder, "{sv}", "CpuDriver",
+                           g_variant_new_string (ppd_driver_get_driver_name (PPD_DRIVER (data->cpu_driver))));
+  if (PPD_IS_DRIVER_PLATFORM (data->platform_driver))
+    g_variant_builder_add (&builder, "{sv}", "PlatformDriver",
+                           g_variant_new_string (ppd_driver_get_driver_name (PPD_DRIVER (data->platform_driver))));
+  g_variant_builder_add (&builder, "{sv}", "LastCookie", g_variant_new_uint32 (data->last_cookie));
+
+  g_variant_builder_init (&holds_builder, G_VARIANT_TYPE ("a(usssss)"));
+  g_hash_table_iter_init (&iter, data->profile_holds);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    ProfileHold *hold = value;
+    PpdClient *client = g_hash_table_lookup (data->clients, hold->requester);
+
+    /* Peer connections do not survive us */
+    if (client && client->connection)
+      continue;
+
+    g_variant_builder_add (&holds_builder, "(usssss)",
+                           GPOINTER_TO_UINT (key),
+                           ppd_profile_to_str (hold->profile),
+                           hold->reason,
+                           hold->application_id,
+                           hold->requester,
+                           hold->requester_iface);
+  }
+  g_variant_builder_add (&builder, "{sv}", "Holds", g_variant_builder_end (&holds_builder));
+
+  return g_variant_builder_end (&builder);
+}
+
+static int
+save_state_to_memfd (PpdApp  *data,
+                     GError **error)
+{
+  g_autoptr(GVariant) state = g_variant_ref_sink (serialize_state (data));
+  g_autoptr(GOutputStream) stream = NULL;
+  int fd;
+
+  /* Not close-on-exec, the next instance inherits it */
+  fd = memfd_create (SAVED_STATE_FD_NAME, 0);
+  if (fd < 0) {
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                 "Could not create memfd: %s", g_strerror (errno));
+    return -1;
+  }
+
+  stream = g_unix_output_stream_new (fd, FALSE);
+  if (!g_output_stream_write_all (stream, g_variant_get_data (state), g_variant_get_size (state),
+                                  NULL, NULL, error)) {
+    close (fd);
+    return -1;
+  }
+
+  if (lseek (fd, 0, SEEK_SET) < 0) {
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                 "Could not rewind memfd: %s", g_strerror (errno));
+    close (fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+static GVariant *
+load_state_from_fd (int      fd,
+                    GError **error)
+{
+  g_autoptr(GInputStream) stream = NULL;
+  g_autoptr(GOutputStream) contents = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+
+  stream = g_unix_input_stream_new (fd, TRUE);
+  if (lseek (fd, 0, SEEK_SET) < 0) {
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                 "Could not rewind saved state: %s", g_strerror (errno));
+    return NULL;
+  }
+
+  contents = g_memory_output_stream_new_resizable ();
+  if (g_output_stream_splice (contents, stream,
+                              G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+                              G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                              NULL, error) < 0)
+    return NULL;
+
+  bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (contents));
+  return g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE_VARDICT, bytes, FALSE));
+}
+
+static void
+restore_profile_hold (PpdApp     *data,
+                      guint       cookie,
+                      const char *profile_name,
+                      const char *reason,
+                      const char *application_id,
+                      const char *requester,
+                      const char *requester_iface)
+{
+  PpdProfile profile = ppd_profile_from_str (profile_name);
+  ProfileHold *hold;
+  PpdClient *client;
+
+  if (cookie == 0 ||
+      (profile != PPD_PROFILE_PERFORMANCE && profile != PPD_PROFILE_POWER_SAVER) ||
+      !g_dbus_is_unique_name (requester) ||
+      g_hash_table_contains (data->profile_holds, GUINT_TO_POINTER (cookie))) {
+    g_debug ("Ignoring invalid saved hold %u", cookie);
+    return;
+  }
+
+  hold = g_new0 (ProfileHold, 1);
+  hold->profile = profile;
+  hold->reason = g_strdup (reason);
+  hold->application_id = g_strdup (application_id);
+  hold->requester = g_strdup (requester);
+  hold->requester_iface = g_strdup (requester_iface);
+
+  g_debug ("Restoring hold %u on profile '%s' for %s (%s)", cookie, profile_name,
+           application_id, requester);
+
+  /* If the requester went away in the meantime, the watch releases the hold */
+  client = get_client (data, requester);
+  add_profile_hold (data, client, cookie, hold);
+}
+
+/* Returns TRUE if the active profile of the previous instance was restored */
+static gboolean
+restore_saved_state (PpdApp *data)
 {
-  if (!PPD_IS_DRIVER_CPU (data->cpu_driver) &&
-      !PPD_IS_DRIVER_PLATFORM (data->platform_driver))
-    return FALSE;
+  g_autoptr(GVariant) state = g_steal_pointer (&data->saved_state);
+  g_autoptr(GVariantIter) holds = NULL;
+  const char *platform_driver = NULL;
+  const char *cpu_driver = NULL;
+  const char *profile_name;
+  PpdProfile profile;
+  guint cookie;
 
-  if (!get_profile_available (data, PPD_PROFILE_BALANCED | PPD_PROFILE_POWER_SAVER))
+  if (state == NULL)
     return FALSE;
 
-  return TRUE;
-}
+  g_info ("Restoring state from the previous instance");
 
-static void
-restart_profile_drivers (PpdApp *data)
-{
-  stop_profile_drivers (data);
-  start_profile_drivers (data);
-}
+  if (g_variant_lookup (state, "SelectedProfile", "&s", &profile_name) &&
+      ppd_profile_from_str (profile_name) != PPD_PROFILE_UNSET)
+    data->selected_profile = ppd_profile_from_str (profile_name);
 
-static void
-driver_probe_request_cb (PpdDriver *driver,
-                         gpointer   user_data)
-{
-  PpdApp *data = user_data;
+  g_variant_lookup (state, "LastCookie", "u", &data->last_cookie);
 
-  restart_profile_drivers (data);
-}
+  if (g_variant_lookup (state, "Holds", "a(usssss)", &holds)) {
+    const char *reason, *application_id, *requester, *requester_iface;
 
-static void
-disconnect_array_objects_signals_by_data (GPtrArray *array,
-                                          void      *data)
-{
-  for (guint i = 0; i < array->len; ++i) {
-    GObject *object = g_ptr_array_index (array, i);
+    while (g_variant_iter_next (holds, "(u&s&s&s&s&s)", &cookie, &profile_name, &reason,
+                                &application_id, &requester, &requester_iface))
+      restore_profile_hold (data, cookie, profile_name, reason, application_id,
+                            requester, requester_iface);
+  }
 
-    g_signal_handlers_disconnect_by_data (object, data);
+  g_variant_lookup (state, "CpuDriver", "&s", &cpu_driver);
+  g_variant_lookup (state, "PlatformDriver", "&s", &platform_driver);
+  if (g_strcmp0 (cpu_driver, PPD_IS_DRIVER_CPU (data->cpu_driver) ?
+                 ppd_driver_get_driver_name (PPD_DRIVER (data->cpu_driver)) : NULL) != 0 ||
+      g_strcmp0 (platform_driver, PPD_IS_DRIVER_PLATFORM (data->platform_driver) ?
+                 ppd_driver_get_driver_name (PPD_DRIVER (data->platform_driver)) : NULL) != 0) {
+    g_debug ("Drivers changed since the state was saved");
+    return FALSE;
   }
-}
 
-static void
-maybe_disconnect_object_by_data (void *object,
-                                 void *data)
-{
-  if (!G_IS_OBJECT (object))
-    return;
+  if (!g_variant_lookup (state, "ActiveProfile", "&s", &profile_name))
+    return FALSE;
+  profile = ppd_profile_from_str (profile_name);
+  if (profile == PPD_PROFILE_UNSET)
+    return FALSE;
 
-  g_signal_handlers_disconnect_by_data (object, data);
+  data->active_profile = profile;
+  return TRUE;
 }
 
-static void
-stop_profile_drivers (PpdApp *data)
+static gboolean
+driver_state_matches (PpdDriver  *driver,
+                      PpdProfile  profile)
 {
-  if (data->logind_sleep_signal_id) {
-    g_dbus_connection_signal_unsubscribe (data->connection, data->logind_sleep_signal_id);
-    data->logind_sleep_signal_id = 0;
-  }
+  PpdProfile state;
 
-  upower_battery_set_power_changed_reason (data, PPD_POWER_CHANGED_REASON_UNKNOWN);
-  release_all_profile_holds (data);
-  g_cancellable_cancel (data->cancellable);
-  disconnect_array_objects_signals_by_data (data->probed_drivers, data);
-  g_ptr_array_set_size (data->probed_drivers, 0);
-  disconnect_array_objects_signals_by_data (data->actions, data);
-  g_ptr_array_set_size (data->actions, 0);
-  g_clear_signal_handler (&data->upower_watch_id, data->upower_proxy);
-  g_clear_signal_handler (&data->upower_properties_id, data->upower_proxy);
-  g_clear_signal_handler (&data->upower_display_watch_id, data->upower_display_proxy);
-  g_clear_signal_handler (&data->upower_display_properties_id, data->upower_display_proxy);
-  g_clear_object (&data->cancellable);
-  maybe_disconnect_object_by_data (data->upower_proxy, data);
-  g_clear_object (&data->upower_proxy);
-  maybe_disconnect_object_by_data (data->upower_display_proxy, data);
-  g_clear_object (&data->upower_display_proxy);
-  maybe_disconnect_object_by_data (data->cpu_driver, data);
-  g_clear_object (&data->cpu_driver);
-  maybe_disconnect_object_by_data (data->platform_driver, data);
-  g_clear_object (&data->platform_driver);
+  /* Nothing would be done for this driver */
+  if (!driver_profile_support (driver, profile) ||
+      PPD_DRIVER_GET_CLASS (driver)->activate_profile == NULL)
+    return TRUE;
+
+  state = ppd_driver_query_state (driver);
+  g_debug ("Driver '%s' reports profile '%s'", ppd_driver_get_driver_name (driver),
+           state == PPD_PROFILE_UNSET ? "unknown" : ppd_profile_to_str (state));
+
+  return state == profile;
 }
 
 static gboolean
-action_blocked (PpdApp *app, PpdAction *action)
+drivers_state_matches (PpdApp     *data,
+                       PpdProfile  profile)
 {
-  const gchar *action_name = ppd_action_get_action_name (action);
-  g_autoptr(GError) error = NULL;
-  gboolean blocked;
-
-  if (app->debug_options->blocked_actions != NULL &&
-      g_strv_length (app->debug_options->blocked_actions) != 0) {
+  return driver_state_matches (PPD_DRIVER (data->cpu_driver), profile) &&
+         driver_state_matches (PPD_DRIVER (data->platform_driver), profile);
+}
 
-    blocked = g_strv_contains ((const gchar *const *) app->debug_options->blocked_actions, action_name);
+static GArray *
+get_object_types (void)
+{
+  GArray *types = g_array_new (FALSE, FALSE, sizeof (GType));
 
-    if (blocked) {
-      g_debug ("Action '%s' is blocked by command line", action_name);
-      return TRUE;
-    }
-  }
+#ifdef HAVE_MODULES
+  const char *modules_dir = g_getenv ("POWER_PROFILE_DAEMON_MODULES_DIR");
 
-  blocked = !g_key_file_get_boolean (app->config, "Actions", action_name, &error);
+  ppd_modules_load_types (modules_dir ? modules_dir : PPD_MODULES_DIR, types);
+#else
+  for (guint i = 0; i < G_N_ELEMENTS (objects); i++) {
+    GType type = objects[i] ();
 
-  /* if not in conffile, fallback to action opt-in */
-  if (error != NULL) {
-    blocked = ppd_action_get_optin (action);
-    g_debug ("Action '%s' is set %s by default", action_name, blocked ? "disabled" : "enabled");
-    return blocked;
+    g_array_append_val (types, type);
   }
+#endif
 
-  g_debug ("Action '%s' is %s by configuration", action_name, blocked ? "disabled" : "enabled");
-  return blocked;
+  return types;
 }
 
-static gboolean
-driver_blocked (PpdApp *app, PpdDriver *driver)
+static void
+logind_monitor_start (PpdApp *data)
 {
-  const gchar *driver_name = ppd_driver_get_driver_name (driver);
-  gboolean blocked;
+  if (data->debug_options->disable_logind) {
+    g_debug ("logind is disabled, let's skip it");
+    return;
+  }
 
-  if (app->debug_options->blocked_drivers == NULL || g_strv_length (app->debug_options->blocked_drivers) == 0)
-    return FALSE;
+  if (data->logind_sleep_signal_id != 0)
+    return;
 
-  blocked = g_strv_contains ((const gchar *const *) app->debug_options->blocked_drivers, driver_name);
-  if (blocked)
-    g_debug ("Driver '%s' is blocked", driver_name);
-  return blocked;
+  data->logind_sleep_signal_id =
+    g_dbus_connection_signal_subscribe (data->connection,
+                                        LOGIND_DBUS_NAME,
+                                        LOGIND_DBUS_INTERFACE,
+                                        "PrepareForSleep",
+                                        LOGIND_DBUS_PATH,
+                                        NULL,
+                                        G_DBUS_SIGNAL_FLAGS_NONE,
+                                        on_logind_prepare_for_sleep_cb,
+                                        data,
+                                        NULL);
+}
+
+static void
+logind_monitor_stop (PpdApp *data)
+{
+  if (data->logind_sleep_signal_id) {
+    g_dbus_connection_signal_unsubscribe (data->connection, data->logind_sleep_signal_id);
+    data->logind_sleep_signal_id = 0;
+  }
 }
 
 static void
@@ -1593,16 +3631,27 @@ start_profile_drivers (PpdApp *data)
 {
   guint i;
   g_autoptr(GError) initial_error = NULL;
-  gboolean needs_battery_state_monitor = FALSE;
-  gboolean needs_battery_change_monitor = FALSE;
   gboolean needs_suspend_monitor = FALSE;
+  gboolean needs_battery_state_monitor;
+  gboolean needs_battery_change_monitor;
+  PpdProfile hold_profile;
+  gint64 start;
+  g_autoptr(GArray) types = NULL;
 
-  data->cancellable = g_cancellable_new ();
+  if (data->debug_options->disable_upower)
+    data->battery_support = FALSE;
 
-  for (i = 0; i < G_N_ELEMENTS (objects); i++) {
+  /* Connect to upower and logind while probing, and drop what the drivers
+   * turn out not to need afterwards */
+  if (data->battery_support && data->cancellable == NULL)
+    upower_monitor_connect (data, TRUE, TRUE);
+  logind_monitor_start (data);
+
+  types = get_object_types ();
+  for (i = 0; i < types->len; i++) {
     g_autoptr(GObject) object = NULL;
 
-    object = g_object_new (objects[i] (), NULL);
+    object = g_object_new (g_array_index (types, GType, i), NULL);
 
     if (PPD_IS_DRIVER (object)) {
       g_autoptr(PpdDriver) driver = PPD_DRIVER (g_steal_pointer (&object));
@@ -1637,149 +3686,384 @@ start_profile_drivers (PpdApp *data)
         continue;
       }
 
-      result = ppd_driver_probe (driver);
-      if (result == PPD_PROBE_RESULT_FAIL) {
-        g_debug ("probe () failed for driver %s, skipping",
-                 ppd_driver_get_driver_name (driver));
-        continue;
-      }
+      start = g_get_monotonic_time ();
+      result = ppd_driver_probe (driver);
+      startup_phase_done (data, start, "probe %s", ppd_driver_get_driver_name (driver));
+      if (result == PPD_PROBE_RESULT_FAIL) {
+        g_debug ("probe () failed for driver %s, skipping",
+                 ppd_driver_get_driver_name (driver));
+        continue;
+      }
+
+      if (result == PPD_PROBE_RESULT_DEFER) {
+        g_signal_connect (G_OBJECT (driver), "probe-request",
+                          G_CALLBACK (driver_probe_request_cb), data);
+        g_ptr_array_add (data->probed_drivers, g_steal_pointer (&driver));
+        continue;
+      }
+
+      if (PPD_IS_DRIVER_CPU (driver))
+        g_set_object (&data->cpu_driver, PPD_DRIVER_CPU (driver));
+      else if (PPD_IS_DRIVER_PLATFORM (driver))
+        g_set_object (&data->platform_driver, PPD_DRIVER_PLATFORM (driver));
+      else
+        g_return_if_reached ();
+
+      if (PPD_DRIVER_GET_CLASS (driver)->prepare_to_sleep != NULL)
+        needs_suspend_monitor = TRUE;
+
+      g_info ("Driver '%s' loaded", ppd_driver_get_driver_name (driver));
+
+      g_signal_connect (G_OBJECT (driver), "notify::performance-degraded",
+                        G_CALLBACK (driver_performance_degraded_changed_cb), data);
+      g_signal_connect (G_OBJECT (driver), "profile-changed",
+                        G_CALLBACK (driver_profile_changed_cb), data);
+      continue;
+    }
+
+    if (PPD_IS_ACTION (object)) {
+      g_autoptr(PpdAction) action = PPD_ACTION (g_steal_pointer (&object));
+
+      g_debug ("Handling action '%s'", ppd_action_get_action_name (action));
+
+      if (action_blocked (data, action)) {
+          ppd_action_set_active (action, FALSE);
+      } else {
+        start = g_get_monotonic_time ();
+        switch (ppd_action_probe(action)) {
+        case PPD_PROBE_RESULT_SUCCESS:
+          ppd_action_set_active (action, TRUE);
+          break;
+        default:
+          ppd_action_set_active (action, FALSE);
+          break;
+        }
+        startup_phase_done (data, start, "probe %s", ppd_action_get_action_name (action));
+      }
+
+      g_info ("Action '%s' active %d",
+              ppd_action_get_action_name (action),
+              ppd_action_get_active (action));
+      g_ptr_array_add (data->actions, g_steal_pointer (&action));
+      continue;
+    }
+
+    g_return_if_reached ();
+  }
+
+  if (!has_required_drivers (data)) {
+    data->ret = EXIT_FAILURE;
+    g_warning ("Some non-optional profile drivers are missing, programmer error");
+    g_main_loop_quit (data->main_loop);
+  }
+
+  /* Set initial state either from configuration, or using the currently selected profile */
+  start = g_get_monotonic_time ();
+  apply_configuration (data);
+  if (restore_saved_state (data))
+    g_info ("Profile '%s' was applied by the previous instance",
+            ppd_profile_to_str (data->active_profile));
+  /* The hardware could have been changed since, by another tool or a
+   * firmware reset, so trust the drivers and not the saved state */
+  if (drivers_state_matches (data, data->active_profile)) {
+    g_info ("Drivers already apply profile '%s', not activating them again",
+            ppd_profile_to_str (data->active_profile));
+    actions_activate_profile (data, data->active_profile);
+  } else if (!activate_target_profile (data, data->active_profile, PPD_PROFILE_ACTIVATION_REASON_RESET, &initial_error)) {
+    g_warning ("Failed to activate initial profile: %s", initial_error->message);
+  }
+
+  /* Holds restored from a previous instance */
+  hold_profile = effective_hold_profile (data);
+  if (hold_profile != PPD_PROFILE_UNSET && hold_profile != data->active_profile)
+    activate_target_profile (data, hold_profile, PPD_PROFILE_ACTIVATION_REASON_PROGRAM_HOLD, NULL);
+  startup_phase_done (data, start, "activation");
+
+  send_dbus_event (data, PROP_ALL);
+  data->was_started = TRUE;
+
+  get_battery_monitor_needs (data, &needs_battery_state_monitor, &needs_battery_change_monitor);
+  if (!needs_battery_state_monitor && !needs_battery_change_monitor) {
+    g_debug ("No battery state monitor required by any driver, disconnecting from upower");
+    upower_monitor_stop (data);
+  }
+
+  if (needs_suspend_monitor) {
+    g_debug ("Suspension state monitor required, monitoring logind...");
+  } else {
+    g_debug ("No suspension monitor required by any driver, let's skip it");
+    logind_monitor_stop (data);
+  }
+
+  reset_idle_timeout (data);
+  dispatch_pending_calls (data);
+  startup_check_ready (data);
+}
+
+static void
+add_unique_strings (GPtrArray  *array,
+                    GStrv       strings)
+{
+  for (guint i = 0; strings != NULL && strings[i] != NULL; i++) {
+    if (!g_ptr_array_find_with_equal_func (array, strings[i], g_str_equal, NULL))
+      g_ptr_array_add (array, g_strdup (strings[i]));
+  }
+}
+
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return g_strcmp0 (*(const char **) a, *(const char **) b);
+}
+
+/* @value keeps the default, or the value from an earlier file, if
+ * @key is invalid */
+static void
+load_integer_setting (GKeyFile   *keyfile,
+                      const char *path,
+                      const char *group,
+                      const char *key,
+                      gint       *value)
+{
+  g_autoptr(GError) error = NULL;
+  gint new_value;
+
+  if (!g_key_file_has_key (keyfile, group, key, NULL))
+    return;
+
+  new_value = g_key_file_get_integer (keyfile, group, key, &error);
+  if (error != NULL) {
+    g_warning ("Ignoring %s.%s in settings file '%s': %s", group, key, path, error->message);
+    return;
+  }
+  *value = new_value;
+}
+
+static void
+load_double_setting (GKeyFile   *keyfile,
+                     const char *path,
+                     const char *group,
+                     const char *key,
+                     gdouble    *value)
+{
+  g_autoptr(GError) error = NULL;
+  gdouble new_value;
+
+  if (!g_key_file_has_key (keyfile, group, key, NULL))
+    return;
+
+  new_value = g_key_file_get_double (keyfile, group, key, &error);
+  if (error != NULL) {
+    g_warning ("Ignoring %s.%s in settings file '%s': %s", group, key, path, error->message);
+    return;
+  }
+  *value = new_value;
+}
+
+static PpdSettings *
+load_settings (PpdApp *data)
+{
+  g_autoptr(GPtrArray) blocked_drivers = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr(GPtrArray) blocked_actions = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr(GPtrArray) files = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GDir) dir = NULL;
+  PpdSettings *settings;
+  const char *name;
+
+  settings = g_new0 (PpdSettings, 1);
+  settings->max_holds_per_client = data->debug_options->max_holds_per_client;
+  settings->hold_rate_limit = data->debug_options->hold_rate_limit;
+  settings->hold_rate_burst = data->debug_options->hold_rate_burst;
+  add_unique_strings (blocked_drivers, data->debug_options->blocked_drivers);
+  add_unique_strings (blocked_actions, data->debug_options->blocked_actions);
+
+  dir = g_dir_open (data->settings_dir, 0, &error);
+  if (dir == NULL)
+    g_debug ("Could not open settings directory '%s': %s", data->settings_dir, error->message);
+
+  while (dir != NULL && (name = g_dir_read_name (dir)) != NULL) {
+    if (g_str_has_suffix (name, ".conf"))
+      g_ptr_array_add (files, g_build_filename (data->settings_dir, name, NULL));
+  }
+
+  /* Later files override earlier ones, like other conf.d directories */
+  g_ptr_array_sort (files, compare_strings);
+
+  for (guint i = 0; i < files->len; i++) {
+    const char *path = g_ptr_array_index (files, i);
+    g_autoptr(GKeyFile) keyfile = g_key_file_new ();
+    g_auto(GStrv) drivers = NULL;
+    g_auto(GStrv) actions = NULL;
+
+    if (!g_key_file_load_from_file (keyfile, path, G_KEY_FILE_NONE, &error)) {
+      g_warning ("Could not load settings file '%s': %s", path, error->message);
+      g_clear_error (&error);
+      continue;
+    }
+    g_debug ("Loaded settings file '%s'", path);
+
+    drivers = g_key_file_get_string_list (keyfile, "Drivers", "Blocked", NULL, NULL);
+    add_unique_strings (blocked_drivers, drivers);
+    actions = g_key_file_get_string_list (keyfile, "Actions", "Blocked", NULL, NULL);
+    add_unique_strings (blocked_actions, actions);
+
+    load_integer_setting (keyfile, path, "Holds", "MaxPerClient", &settings->max_holds_per_client);
+    load_double_setting (keyfile, path, "Holds", "RateLimit", &settings->hold_rate_limit);
+    load_integer_setting (keyfile, path, "Holds", "RateBurst", &settings->hold_rate_burst);
+  }
+
+  /* New clients start with a full burst, which has to allow a request */
+  settings->hold_rate_burst = MAX (settings->hold_rate_burst, 1);
+
+  g_ptr_array_add (blocked_drivers, NULL);
+  settings->blocked_drivers = (GStrv) g_ptr_array_free (g_steal_pointer (&blocked_drivers), FALSE);
+  g_ptr_array_add (blocked_actions, NULL);
+  settings->blocked_actions = (GStrv) g_ptr_array_free (g_steal_pointer (&blocked_actions), FALSE);
+
+  return settings;
+}
+
+static gboolean
+loaded_driver_has_name (PpdApp     *data,
+                        const char *driver_name)
+{
+  if (data->cpu_driver &&
+      g_str_equal (ppd_driver_get_driver_name (PPD_DRIVER (data->cpu_driver)), driver_name))
+    return TRUE;
+  if (data->platform_driver &&
+      g_str_equal (ppd_driver_get_driver_name (PPD_DRIVER (data->platform_driver)), driver_name))
+    return TRUE;
+  return FALSE;
+}
+
+static gboolean
+driver_selection_changed (PpdApp      *data,
+                          PpdSettings *old_settings)
+{
+  const char * const *old_blocked = (const char * const *) old_settings->blocked_drivers;
+  const char * const *new_blocked = (const char * const *) data->settings->blocked_drivers;
 
-      if (result == PPD_PROBE_RESULT_DEFER) {
-        g_signal_connect (G_OBJECT (driver), "probe-request",
-                          G_CALLBACK (driver_probe_request_cb), data);
-        g_ptr_array_add (data->probed_drivers, g_steal_pointer (&driver));
-        continue;
-      }
+  /* A loaded driver is now blocked */
+  for (guint i = 0; new_blocked[i] != NULL; i++) {
+    if (!g_strv_contains (old_blocked, new_blocked[i]) &&
+        loaded_driver_has_name (data, new_blocked[i]))
+      return TRUE;
+  }
 
-      if (PPD_IS_DRIVER_CPU (driver))
-        g_set_object (&data->cpu_driver, PPD_DRIVER_CPU (driver));
-      else if (PPD_IS_DRIVER_PLATFORM (driver))
-        g_set_object (&data->platform_driver, PPD_DRIVER_PLATFORM (driver));
-      else
-        g_return_if_reached ();
+  /* A driver that was skipped might be picked now */
+  for (guint i = 0; old_blocked[i] != NULL; i++) {
+    if (!g_strv_contains (new_blocked, old_blocked[i]))
+      return TRUE;
+  }
 
-      if (PPD_DRIVER_GET_CLASS (driver)->power_changed != NULL)
-        needs_battery_state_monitor = TRUE;
+  return FALSE;
+}
 
-      if (PPD_DRIVER_GET_CLASS (driver)->battery_changed != NULL)
-        needs_battery_change_monitor = TRUE;
+static void
+reprobe_profile_drivers (PpdApp *data)
+{
+  PpdProfile hold_profile;
 
-      if (PPD_DRIVER_GET_CLASS (driver)->prepare_to_sleep != NULL)
-        needs_suspend_monitor = TRUE;
+  freeze_dbus_events (data);
 
-      g_info ("Driver '%s' loaded", ppd_driver_get_driver_name (driver));
+  data->preserve_holds = TRUE;
+  restart_profile_drivers (data);
+  data->preserve_holds = FALSE;
 
-      g_signal_connect (G_OBJECT (driver), "notify::performance-degraded",
-                        G_CALLBACK (driver_performance_degraded_changed_cb), data);
-      g_signal_connect (G_OBJECT (driver), "profile-changed",
-                        G_CALLBACK (driver_profile_changed_cb), data);
-      continue;
-    }
+  hold_profile = effective_hold_profile (data);
+  if (hold_profile != PPD_PROFILE_UNSET && hold_profile != data->active_profile) {
+    activate_target_profile (data, hold_profile, PPD_PROFILE_ACTIVATION_REASON_PROGRAM_HOLD, NULL);
+    send_dbus_event (data, PROP_ACTIVE_PROFILE);
+  }
 
-    if (PPD_IS_ACTION (object)) {
-      g_autoptr(PpdAction) action = PPD_ACTION (g_steal_pointer (&object));
+  thaw_dbus_events (data);
+}
 
-      g_debug ("Handling action '%s'", ppd_action_get_action_name (action));
+static gboolean
+reload_settings (gpointer user_data)
+{
+  g_autoptr(PpdSettings) old_settings = NULL;
+  gboolean actions_changed = FALSE;
+  PpdApp *data = user_data;
 
-      if (action_blocked (data, action)) {
-          ppd_action_set_active (action, FALSE);
-      } else {
-        switch (ppd_action_probe(action)) {
-        case PPD_PROBE_RESULT_SUCCESS:
-          ppd_action_set_active (action, TRUE);
-          break;
-        default:
-          ppd_action_set_active (action, FALSE);
-          break;
-        }
-      }
+  data->settings_reload_id = 0;
 
-      if (PPD_ACTION_GET_CLASS (action)->power_changed != NULL)
-        needs_battery_state_monitor = TRUE;
+  g_info ("Reloading settings from '%s'", data->settings_dir);
+  old_settings = g_steal_pointer (&data->settings);
+  data->settings = load_settings (data);
 
-      if (PPD_ACTION_GET_CLASS (action)->battery_changed != NULL)
-        needs_battery_change_monitor = TRUE;
+  if (!data->was_started)
+    return G_SOURCE_REMOVE;
 
-      g_info ("Action '%s' active %d",
-              ppd_action_get_action_name (action),
-              ppd_action_get_active (action));
-      g_ptr_array_add (data->actions, g_steal_pointer (&action));
+  for (guint i = 0; i < data->actions->len; i++) {
+    PpdAction *action = g_ptr_array_index (data->actions, i);
+    const char *action_name = ppd_action_get_action_name (action);
+
+    if (g_strv_contains ((const char * const *) old_settings->blocked_actions, action_name) ==
+        g_strv_contains ((const char * const *) data->settings->blocked_actions, action_name))
       continue;
-    }
 
-    g_return_if_reached ();
+    refresh_action (data, action);
+    actions_changed = TRUE;
   }
 
-  if (!has_required_drivers (data)) {
-    data->ret = EXIT_FAILURE;
-    g_warning ("Some non-optional profile drivers are missing, programmer error");
-    g_main_loop_quit (data->main_loop);
+  if (actions_changed)
+    send_dbus_event (data, PROP_ACTIONS);
+
+  if (driver_selection_changed (data, old_settings)) {
+    g_info ("Driver blocklist changed, probing drivers again");
+    reprobe_profile_drivers (data);
   }
 
-  /* Set initial state either from configuration, or using the currently selected profile */
-  apply_configuration (data);
-  if (!activate_target_profile (data, data->active_profile, PPD_PROFILE_ACTIVATION_REASON_RESET, &initial_error))
-    g_warning ("Failed to activate initial profile: %s", initial_error->message);
+  return G_SOURCE_REMOVE;
+}
 
-  send_dbus_event (data, PROP_ALL);
-  data->was_started = TRUE;
+static void
+settings_dir_changed_cb (GFileMonitor      *monitor,
+                         GFile             *file,
+                         GFile             *other_file,
+                         GFileMonitorEvent  event_type,
+                         gpointer           user_data)
+{
+  PpdApp *data = user_data;
+  g_auto(PpdWatchdogScope) scope = ppd_watchdog_enter ("signal", "settings-changed");
 
-  if (data->debug_options->disable_upower)
-    data->battery_support = FALSE;
+  /* Wait for CHANGES_DONE_HINT rather than reloading half-written files */
+  if (event_type == G_FILE_MONITOR_EVENT_CHANGED ||
+      event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED)
+    return;
 
-  if (!data->battery_support) {
-    g_debug ("upower is disabled, let's skip it");
-  } else if (needs_battery_state_monitor || needs_battery_change_monitor) {
-    /* start watching for power changes */
-    if (needs_battery_state_monitor) {
-      g_debug ("Battery state monitor required, connecting to upower...");
-      g_dbus_proxy_new (data->connection,
-                        G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START |
-                        G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
-                        NULL,
-                        UPOWER_DBUS_NAME,
-                        UPOWER_DBUS_PATH,
-                        UPOWER_DBUS_INTERFACE,
-                        data->cancellable,
-                        on_upower_proxy_cb,
-                        data);
-    }
+  if (data->settings_reload_id != 0)
+    return;
 
-    if (needs_battery_change_monitor) {
-      g_debug ("Battery change monitor required, connecting to upower...");
-      g_dbus_proxy_new (data->connection,
-                        G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START |
-                        G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
-                        NULL,
-                        UPOWER_DBUS_NAME,
-                        UPOWER_DBUS_DISPLAY_DEVICE_PATH,
-                        UPOWER_DBUS_DEVICE_INTERFACE,
-                        data->cancellable,
-                        on_upower_display_proxy_cb,
-                        data);
-    }
-  } else {
-    g_debug ("No battery state monitor required by any driver, let's skip it");
-  }
+  data->settings_reload_id = ppd_watchdog_timeout_add (SETTINGS_RELOAD_DELAY_MSEC, "settings-reload",
+                                                       reload_settings, data);
+}
 
-  if (data->debug_options->disable_logind) {
-    g_debug ("logind is disabled, let's skip it");
-  } else if (needs_suspend_monitor) {
-    g_debug ("Suspension state monitor required, monitoring logind...");
-    data->logind_sleep_signal_id =
-      g_dbus_connection_signal_subscribe (data->connection,
-                                          LOGIND_DBUS_NAME,
-                                          LOGIND_DBUS_INTERFACE,
-                                          "PrepareForSleep",
-                                          LOGIND_DBUS_PATH,
-                                          NULL,
-                                          G_DBUS_SIGNAL_FLAGS_NONE,
-                                          on_logind_prepare_for_sleep_cb,
-                                          data,
-                                          NULL);
-  } else {
-    g_debug ("No suspension monitor required by any driver, let's skip it");
+static void
+setup_settings (PpdApp *data)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GFile) dir = NULL;
+
+  if (g_getenv ("UMOCKDEV_DIR") != NULL)
+    data->settings_dir = g_build_filename (g_getenv ("UMOCKDEV_DIR"), "ppd_test_conf.d", NULL);
+  else
+    data->settings_dir = g_strdup (PPD_SETTINGS_DIR);
+
+  data->settings = load_settings (data);
+
+  dir = g_file_new_for_path (data->settings_dir);
+  data->settings_monitor = g_file_monitor_directory (dir, G_FILE_MONITOR_WATCH_MOVES, NULL, &error);
+  if (data->settings_monitor == NULL) {
+    g_warning ("Could not monitor settings directory '%s': %s", data->settings_dir, error->message);
+    return;
   }
+
+  g_signal_connect (data->settings_monitor, "changed",
+                    G_CALLBACK (settings_dir_changed_cb), data);
 }
 
 void
@@ -1798,6 +4082,11 @@ name_acquired_handler (GDBusConnection *connection,
 
   g_debug ("Name '%s' acquired", name);
 
+  if (data->app->startup_mark != 0) {
+    startup_phase_done (data->app, data->app->startup_mark, "bus-name");
+    data->app->startup_mark = 0;
+  }
+
   start_profile_drivers (data->app);
 }
 
@@ -1839,6 +4128,8 @@ setup_dbus (PpdApp    *data,
   own_data->app = data;
   own_data->interface = g_dbus_interface_info_ref (introspection_data->interfaces[0]);
   own_data->legacy_interface = g_dbus_interface_info_ref (legacy_introspection_data->interfaces[0]);
+  data->interface_info = g_dbus_interface_info_ref (own_data->interface);
+  data->legacy_interface_info = g_dbus_interface_info_ref (own_data->legacy_interface);
 
   own_data->flags = G_BUS_NAME_OWNER_FLAGS_ALLOW_REPLACEMENT;
   if (data->debug_options->replace)
@@ -1862,20 +4153,73 @@ free_app_data (PpdApp *data)
   if (data == NULL)
     return;
 
+  ppd_watchdog_stop ();
   stop_profile_drivers (data);
 
   g_clear_handle_id (&data->name_id, g_bus_unown_name);
   g_clear_handle_id (&data->legacy_name_id, g_bus_unown_name);
 
+  if (data->peer_server) {
+    g_dbus_server_stop (data->peer_server);
+    g_clear_object (&data->peer_server);
+    g_unlink (data->peer_socket_path);
+  }
+  g_clear_pointer (&data->peer_socket_path, g_free);
+  if (data->metrics_service) {
+    g_socket_service_stop (data->metrics_service);
+    g_socket_listener_close (G_SOCKET_LISTENER (data->metrics_service));
+    g_clear_object (&data->metrics_service);
+    g_unlink (data->metrics_path);
+  }
+  g_clear_pointer (&data->metrics_path, g_free);
+  g_clear_pointer (&data->metrics, ppd_metrics_unref);
+  g_clear_pointer (&data->energy, ppd_energy_free);
+  g_clear_pointer (&data->peer_interface, g_dbus_interface_info_unref);
+  g_clear_pointer (&data->interface_info, g_dbus_interface_info_unref);
+  g_clear_pointer (&data->legacy_interface_info, g_dbus_interface_info_unref);
+  disconnect_array_objects_signals_by_data (data->peers, data);
+  g_clear_pointer (&data->peers, g_ptr_array_unref);
+
+  g_info ("Configuration saves requested: %" G_GUINT64_FORMAT ", written: %" G_GUINT64_FORMAT
+          ", merged: %" G_GUINT64_FORMAT ", superseded: %" G_GUINT64_FORMAT,
+          ppd_stats_get_count (data->stats, "config-saves-requested"),
+          ppd_stats_get_count (data->stats, "config-saves-written"),
+          ppd_stats_get_count (data->stats, "config-saves-merged"),
+          ppd_stats_get_count (data->stats, "config-saves-superseded"));
+  g_info ("Authorization cache hits: %" G_GUINT64_FORMAT ", misses: %" G_GUINT64_FORMAT,
+          ppd_stats_get_count (data->stats, "auth-cache-hits"),
+          ppd_stats_get_count (data->stats, "auth-cache-misses"));
+  g_clear_handle_id (&data->config_save_id, g_source_remove);
+
+  g_clear_handle_id (&data->idle_exit_id, g_source_remove);
+  g_clear_pointer (&data->saved_state, g_variant_unref);
+  g_clear_pointer (&data->argv, g_strfreev);
+  g_clear_pointer (&data->startup_phases, g_array_unref);
+  g_clear_handle_id (&data->settings_reload_id, g_source_remove);
+  maybe_disconnect_object_by_data (data->settings_monitor, data);
+  g_clear_object (&data->settings_monitor);
+  g_clear_pointer (&data->settings_dir, g_free);
+  g_clear_pointer (&data->settings, settings_free);
   g_clear_pointer (&data->debug_options, debug_options_free);
   g_clear_pointer (&data->config_path, g_free);
   g_clear_pointer (&data->config, g_key_file_unref);
+  g_clear_pointer (&data->stats, ppd_stats_unref);
   g_clear_pointer (&data->probed_drivers, g_ptr_array_unref);
   g_clear_pointer (&data->actions, g_ptr_array_unref);
   g_clear_object (&data->cpu_driver);
   g_clear_object (&data->platform_driver);
   g_hash_table_destroy (data->profile_holds);
 
+  if (data->pending_calls) {
+    GDBusMethodInvocation *invocation;
+
+    while ((invocation = g_queue_pop_head (data->pending_calls)) != NULL)
+      g_dbus_method_invocation_return_error_literal (invocation, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+                                                     "power-profiles-daemon is exiting");
+    g_clear_pointer (&data->pending_calls, g_queue_free);
+  }
+  g_clear_pointer (&data->clients, g_hash_table_unref);
+  g_clear_signal_handler (&data->auth_changed_id, data->auth);
   g_clear_object (&data->auth);
 
   g_clear_pointer (&data->main_loop, g_main_loop_unref);
@@ -1939,15 +4283,220 @@ debug_handler_cb (const gchar *log_domain,
     g_print ("%s\n", message);
 }
 
+#ifdef HAVE_LIBSYSTEMD
+/* Whether systemd stops the service to start it again right away, in which
+ * case the next instance takes the holds over, rather than for good */
+static gboolean
+unit_is_restarting (PpdApp *data)
+{
+  g_autoptr(GVariant) jobs = NULL;
+  g_autoptr(GVariantIter) iter = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *unit = NULL;
+  const char *job_unit;
+  const char *job_type;
+  int r;
+
+  if (data->connection == NULL)
+    return FALSE;
+
+  r = sd_pid_get_unit (0, &unit);
+  if (r < 0) {
+    g_debug ("Could not find our systemd unit: %s", g_strerror (-r));
+    return FALSE;
+  }
+
+  /* A single call, as this delays stopping */
+  jobs = g_dbus_connection_call_sync (data->connection,
+                                      SYSTEMD_DBUS_NAME,
+                                      SYSTEMD_DBUS_PATH,
+                                      SYSTEMD_DBUS_INTERFACE,
+                                      "ListJobs",
+                                      NULL,
+                                      G_VARIANT_TYPE ("(a(usssoo))"),
+                                      G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                      SYSTEMD_CALL_TIMEOUT_MSEC,
+                                      NULL,
+                                      &error);
+  if (jobs == NULL) {
+    g_debug ("Could not list the systemd jobs: %s", error->message);
+    return FALSE;
+  }
+
+  /* systemd turns the other kinds of restarts into this one when queuing
+   * them, and only turns it into a start once we are stopped */
+  g_variant_get (jobs, "(a(usssoo))", &iter);
+  while (g_variant_iter_next (iter, "(u&s&s&s&o&o)", NULL, &job_unit, &job_type,
+                              NULL, NULL, NULL)) {
+    if (g_str_equal (job_unit, unit)) {
+      g_debug ("Stopped by a systemd job of type '%s'", job_type);
+      return g_str_equal (job_type, "restart");
+    }
+  }
+
+  return FALSE;
+}
+
+static void
+store_state_in_fdstore (PpdApp *data)
+{
+  g_autoptr(GError) error = NULL;
+  int fd;
+  int r;
+
+  if (!data->was_started || g_getenv ("NOTIFY_SOCKET") == NULL)
+    return;
+
+  /* On a plain stop, the holds are released and their owners told so */
+  if (!unit_is_restarting (data)) {
+    g_debug ("Not restarting, not keeping the state for the next instance");
+    return;
+  }
+
+  fd = save_state_to_memfd (data, &error);
+  if (fd < 0) {
+    g_warning ("Could not save state: %s", error->message);
+    return;
+  }
+
+  r = sd_pid_notify_with_fds (0, 0, "FDSTORE=1\nFDNAME=" SAVED_STATE_FD_NAME, &fd, 1);
+  close (fd);
+  if (r <= 0) {
+    g_warning ("Could not store state in the systemd file descriptor store: %s",
+               r < 0 ? g_strerror (-r) : "not supported");
+    return;
+  }
+
+  /* The next instance takes the holds over, don't release them */
+  g_debug ("Stored state in the systemd file descriptor store");
+  data->preserve_holds = TRUE;
+}
+
+static void
+load_state_from_fdstore (PpdApp *data)
+{
+  g_auto(GStrv) names = NULL;
+  int n_fds;
+
+  n_fds = sd_listen_fds_with_names (TRUE, &names);
+  for (int i = 0; i < n_fds; i++) {
+    g_autoptr(GError) error = NULL;
+    int fd = SD_LISTEN_FDS_START + i;
+
+    if (names == NULL || g_strcmp0 (names[i], SAVED_STATE_FD_NAME) != 0) {
+      close (fd);
+      continue;
+    }
+
+    g_clear_pointer (&data->saved_state, g_variant_unref);
+    data->saved_state = load_state_from_fd (fd, &error);
+    if (data->saved_state == NULL)
+      g_warning ("Could not load the saved state: %s", error->message);
+  }
+
+  /* It was consumed, don't hand it to the next instance again */
+  if (n_fds > 0)
+    sd_notify (0, "FDSTOREREMOVE=1\nFDNAME=" SAVED_STATE_FD_NAME);
+}
+#endif
+
 static gboolean
 quit_signal_callback (gpointer user_data)
 {
   PpdApp *data = user_data;
 
+  flush_configuration (data);
+#ifdef HAVE_LIBSYSTEMD
+  store_state_in_fdstore (data);
+#endif
   g_main_loop_quit (data->main_loop);
   return FALSE;
 }
 
+static gboolean
+dump_events_signal_callback (gpointer user_data)
+{
+  ppd_recorder_dump ();
+  return G_SOURCE_CONTINUE;
+}
+
+static char *
+get_executable_path (PpdApp *data)
+{
+  g_autofree char *path = NULL;
+
+  /* After an upgrade, the link points to the removed binary */
+  path = g_file_read_link ("/proc/self/exe", NULL);
+  if (path == NULL)
+    return g_strdup (data->argv[0]);
+  if (g_str_has_suffix (path, " (deleted)"))
+    path[strlen (path) - strlen (" (deleted)")] = '\0';
+
+  return g_steal_pointer (&path);
+}
+
+/* Without libsystemd, the unit is of Type=dbus, and systemd takes the bus
+ * name going away during the re-exec for the service exiting */
+static gboolean
+can_reexec (void)
+{
+#ifdef HAVE_LIBSYSTEMD
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+static gboolean
+reexec_signal_callback (gpointer user_data)
+{
+  PpdApp *data = user_data;
+  g_autoptr(GPtrArray) args = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *path = NULL;
+  int fd;
+
+  if (!data->was_started) {
+    g_debug ("Not started yet, ignoring re-exec request");
+    return G_SOURCE_CONTINUE;
+  }
+
+  if (!can_reexec ()) {
+    g_warning ("Re-executing needs systemd notification support, restart the service instead");
+    return G_SOURCE_CONTINUE;
+  }
+
+  flush_configuration (data);
+  fd = save_state_to_memfd (data, &error);
+  if (fd < 0) {
+    g_warning ("Could not save state, not re-executing: %s", error->message);
+    return G_SOURCE_CONTINUE;
+  }
+
+  args = g_ptr_array_new_with_free_func (g_free);
+  for (guint i = 0; data->argv[i] != NULL; i++) {
+    if (!g_str_has_prefix (data->argv[i], "--restore-state-fd="))
+      g_ptr_array_add (args, g_strdup (data->argv[i]));
+  }
+  g_ptr_array_add (args, g_strdup_printf ("--restore-state-fd=%d", fd));
+  g_ptr_array_add (args, NULL);
+
+  path = get_executable_path (data);
+  g_info ("Re-executing '%s' with the current state", path);
+#ifdef HAVE_LIBSYSTEMD
+  /* The PID stays the same, the new instance sends READY=1 once started */
+  sd_notify (0, "RELOADING=1\nSTATUS=Re-executing");
+#endif
+  execv (path, (char **) args->pdata);
+
+  g_warning ("Could not re-execute '%s': %s", path, g_strerror (errno));
+#ifdef HAVE_LIBSYSTEMD
+  sd_notify (0, "READY=1");
+#endif
+  close (fd);
+  return G_SOURCE_CONTINUE;
+}
+
 static gboolean
 verbose_arg_cb (const gchar *option_name,
                 const gchar *value,
@@ -2034,6 +4583,87 @@ debug_pre_parse_hook (GOptionContext *context,
       "Disable logind integration",
       NULL,
     },
+    {
+      "disable-legacy-name",
+      0,
+      G_OPTION_FLAG_NONE,
+      G_OPTION_ARG_NONE,
+      &data->disable_legacy_name,
+      "Do not own the legacy net.hadess.PowerProfiles name, build with -Dlegacy_name=false to also drop its D-Bus activation",
+      NULL,
+    },
+    {
+      "peer-socket",
+      0,
+      G_OPTION_FLAG_NONE,
+      G_OPTION_ARG_NONE,
+      &data->peer_socket,
+      "Also serve clients on a private socket in /run/power-profiles-daemon",
+      NULL,
+    },
+    {
+      "metrics-socket",
+      0,
+      G_OPTION_FLAG_NONE,
+      G_OPTION_ARG_NONE,
+      &data->metrics_socket,
+      "Serve OpenMetrics text on a socket in /run/power-profiles-daemon",
+      NULL,
+    },
+    {
+      "max-holds-per-client",
+      0,
+      G_OPTION_FLAG_NONE,
+      G_OPTION_ARG_INT,
+      &data->max_holds_per_client,
+      "Maximum number of profile holds per client, 0 for unlimited",
+      "N",
+    },
+    {
+      "hold-rate-limit",
+      0,
+      G_OPTION_FLAG_NONE,
+      G_OPTION_ARG_DOUBLE,
+      &data->hold_rate_limit,
+      "Hold requests allowed per second and client, 0 for unlimited",
+      "RATE",
+    },
+    {
+      "hold-rate-burst",
+      0,
+      G_OPTION_FLAG_NONE,
+      G_OPTION_ARG_INT,
+      &data->hold_rate_burst,
+      "Hold requests a client can make in a burst, at least 1",
+      "N",
+    },
+    {
+      "idle-exit",
+      0,
+      G_OPTION_FLAG_NONE,
+      G_OPTION_ARG_INT,
+      &data->idle_exit_timeout,
+      "Exit after this many seconds without requests, when nothing needs monitoring",
+      "SECONDS",
+    },
+    {
+      "stall-threshold",
+      0,
+      G_OPTION_FLAG_NONE,
+      G_OPTION_ARG_INT,
+      &data->stall_threshold,
+      "Warn when the main loop is blocked for longer than this, 0 to disable",
+      "MS",
+    },
+    {
+      "restore-state-fd",
+      0,
+      G_OPTION_FLAG_HIDDEN,
+      G_OPTION_ARG_INT,
+      &data->restore_state_fd,
+      "Restore the state saved by a previous instance in this file descriptor",
+      "FD",
+    },
     { NULL }
   };
   g_option_group_add_entries (group, options);
@@ -2060,8 +4690,16 @@ int main (int argc, char **argv)
   g_autoptr(PpdApp) data = NULL;
   g_autoptr(GOptionContext) option_context = NULL;
   g_autoptr(GError) error = NULL;
+  g_auto(GStrv) saved_argv = g_strdupv (argv);
+  gint64 startup_time = g_get_monotonic_time ();
+  gint64 start;
 
   debug_options->log_level = G_LOG_LEVEL_MESSAGE;
+  debug_options->restore_state_fd = -1;
+  debug_options->max_holds_per_client = 32;
+  debug_options->hold_rate_limit = 10;
+  debug_options->hold_rate_burst = 20;
+  debug_options->stall_threshold = 500;
   debug_options->group = g_option_group_new ("debug",
                                              "Debugging Options",
                                              "Show debugging options",
@@ -2082,28 +4720,71 @@ int main (int argc, char **argv)
 
   data = g_new0 (PpdApp, 1);
   data->main_loop = g_main_loop_new (NULL, TRUE);
-  data->auth = polkit_authority_get_sync (NULL, NULL);
+  data->startup_time = startup_time;
+  data->startup_phases = g_array_new (FALSE, FALSE, sizeof (StartupPhase));
+  g_array_set_clear_func (data->startup_phases, (GDestroyNotify) startup_phase_clear);
+
+  /* Authorization checks wait for this, the bus name does not */
+  data->auth_requested = g_get_monotonic_time ();
+  polkit_authority_get_async (NULL, polkit_authority_ready_cb, data);
+  data->clients = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) client_free);
+  data->peers = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+  data->pending_calls = g_queue_new ();
+  data->stats = ppd_stats_ref (ppd_stats_get_default ());
+  data->energy = ppd_energy_new ();
   data->probed_drivers = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
   data->actions = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
   data->profile_holds = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) profile_hold_free);
   data->active_profile = PPD_PROFILE_BALANCED;
   data->selected_profile = PPD_PROFILE_BALANCED;
   data->debug_options = g_steal_pointer(&debug_options);
+  data->argv = g_steal_pointer (&saved_argv);
 
-  g_unix_signal_add (SIGTERM, quit_signal_callback, data);
-  g_unix_signal_add (SIGINT, quit_signal_callback, data);
+  ppd_watchdog_unix_signal_add (SIGTERM, "SIGTERM", quit_signal_callback, data);
+  ppd_watchdog_unix_signal_add (SIGINT, "SIGINT", quit_signal_callback, data);
+  ppd_watchdog_unix_signal_add (SIGHUP, "SIGHUP", reexec_signal_callback, data);
+  ppd_watchdog_unix_signal_add (SIGUSR1, "SIGUSR1", dump_events_signal_callback, data);
 
   g_info ("Starting power-profiles-daemon version "VERSION);
 
+  start = g_get_monotonic_time ();
   load_configuration (data);
+  setup_settings (data);
+
+  if (data->debug_options->restore_state_fd >= 0) {
+    data->saved_state = load_state_from_fd (data->debug_options->restore_state_fd, &error);
+    if (data->saved_state == NULL) {
+      g_warning ("Could not load the saved state: %s", error->message);
+      g_clear_error (&error);
+    }
+  }
+#ifdef HAVE_LIBSYSTEMD
+  else {
+    load_state_from_fdstore (data);
+  }
+#endif
+  startup_phase_done (data, start, "configuration");
   ppd_app = data;
 
+  if (data->debug_options->metrics_socket &&
+      !setup_metrics_server (data, &error)) {
+    g_warning ("Failed to set up the metrics socket: %s", error->message);
+    g_clear_error (&error);
+  }
+
   /* Set up D-Bus */
+  data->startup_mark = g_get_monotonic_time ();
   if (!setup_dbus (data, &error)) {
     g_error ("Failed to start dbus: %s", error->message);
     return EXIT_FAILURE;
   }
 
+  if (data->debug_options->stall_threshold > 0 &&
+      !ppd_watchdog_start (data->debug_options->stall_threshold * G_TIME_SPAN_MILLISECOND, &error)) {
+    g_warning ("Failed to start the stall watchdog: %s", error->message);
+    g_clear_error (&error);
+  }
+
   g_main_loop_run (data->main_loop);
 
   return data->ret;
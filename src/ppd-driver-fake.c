@@ -26,6 +26,7 @@ struct _PpdDriverFake
   GIOChannel *channel;
   guint watch_id;
   gboolean degraded;
+  PpdProfile activated_profile;
 };
 
 G_DEFINE_TYPE (PpdDriverFake, ppd_driver_fake, PPD_TYPE_DRIVER_PLATFORM)
@@ -173,9 +174,17 @@ ppd_driver_fake_activate_profile (PpdDriver                   *driver,
            ppd_profile_to_str (profile),
            ppd_profile_activation_reason_to_str (reason));
 
+  PPD_DRIVER_FAKE (driver)->activated_profile = profile;
+
   return TRUE;
 }
 
+static PpdProfile
+ppd_driver_fake_query_state (PpdDriver *driver)
+{
+  return PPD_DRIVER_FAKE (driver)->activated_profile;
+}
+
 static void
 ppd_driver_fake_finalize (GObject *object)
 {
@@ -202,6 +211,7 @@ ppd_driver_fake_class_init (PpdDriverFakeClass *klass)
   driver_class = PPD_DRIVER_CLASS (klass);
   driver_class->probe = ppd_driver_fake_probe;
   driver_class->activate_profile = ppd_driver_fake_activate_profile;
+  driver_class->query_state = ppd_driver_fake_query_state;
 }
 
 static void
@@ -115,16 +115,18 @@ call_tlp (const char  *subcommand,
           GError     **error)
 {
     gboolean ret = TRUE;
+    g_autofree char *tlp_path = NULL;
     g_autofree char *cmd = NULL;
     g_autoptr(GError) internal_error = NULL;
 
-    cmd = g_strdup_printf ("%s %s", TLP_PATH, subcommand);
+    tlp_path = ppd_utils_get_sysfs_path (TLP_PATH);
+    cmd = g_strdup_printf ("%s %s", tlp_path, subcommand);
     g_debug ("Executing '%s'", cmd);
-    if (!g_spawn_command_line_sync (cmd,
-                                    NULL,
-                                    NULL,
-                                    NULL,
-                                    &internal_error)) {
+    if (!ppd_utils_spawn_command_line_sync (cmd,
+                                            NULL,
+                                            NULL,
+                                            NULL,
+                                            &internal_error)) {
         g_warning ("Failed to execute '%s': %s",
                    cmd,
                    internal_error->message);
@@ -138,7 +140,9 @@ call_tlp (const char  *subcommand,
 static PpdProbeResult
 probe_tlp (PpdDriverTlp *tlp)
 {
-    if (!g_file_test (TLP_PATH, G_FILE_TEST_EXISTS)) {
+    g_autofree char *tlp_path = ppd_utils_get_sysfs_path (TLP_PATH);
+
+    if (!g_file_test (tlp_path, G_FILE_TEST_EXISTS)) {
         g_debug ("TLP is not installed");
         return PPD_PROBE_RESULT_FAIL;
     }
@@ -204,6 +208,15 @@ ppd_driver_tlp_activate_profile (PpdDriver                    *driver,
     return ret;
 }
 
+static PpdProfile
+ppd_driver_tlp_query_state (PpdDriver *driver)
+{
+    PpdDriverTlp *tlp = PPD_DRIVER_TLP (driver);
+
+    /* Read from the backend's state on probe */
+    return tlp->activated_profile;
+}
+
 static void
 ppd_driver_tlp_finalize (GObject *object)
 {
@@ -223,6 +236,7 @@ ppd_driver_tlp_class_init (PpdDriverTlpClass *klass)
     driver_class = PPD_DRIVER_CLASS(klass);
     driver_class->probe = ppd_driver_tlp_probe;
     driver_class->activate_profile = ppd_driver_tlp_activate_profile;
+    driver_class->query_state = ppd_driver_tlp_query_state;
 }
 
 static void
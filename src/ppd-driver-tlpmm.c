@@ -18,7 +18,7 @@ static gboolean tlpmm_get_cmd_path(gchar *cmd_name,gchar **cmd_result) {
   g_autoptr(GError) internal_error = NULL;
   g_autofree gchar *cmd_line = g_strconcat("which ",cmd_name,NULL);
   gint exit_status;
-  gboolean success = g_spawn_command_line_sync(
+  gboolean success = ppd_utils_spawn_command_line_sync(
     cmd_line,
     &stdout_buf,
     &stderr_buf,
@@ -39,7 +39,7 @@ static gboolean tlpmm_get_profile_base(gchar *TLPMM_CTL_PATH , gchar *mode , gch
   g_autoptr(GError) internal_error = NULL;
   g_autofree gchar *cmd_line = g_strconcat(TLPMM_CTL_PATH," ",mode,NULL);
   gint exit_status;
-  gboolean success = g_spawn_command_line_sync(
+  gboolean success = ppd_utils_spawn_command_line_sync(
     cmd_line,
     &stdout_buf,
     &stderr_buf,
@@ -161,11 +161,11 @@ call_tlpmm (const char  *subcommand,
     }
     cmd = g_strdup_printf ("%s %s", TLPMM_CTL_PATH, subcommand);
     g_debug ("Executing '%s'", cmd);
-    if (!g_spawn_command_line_sync (cmd,
-                                    NULL,
-                                    NULL,
-                                    NULL,
-                                    &internal_error)) {
+    if (!ppd_utils_spawn_command_line_sync (cmd,
+                                            NULL,
+                                            NULL,
+                                            NULL,
+                                            &internal_error)) {
         g_warning ("Failed to execute '%s': %s",
                    cmd,
                    internal_error->message);
@@ -251,6 +251,15 @@ ppd_driver_tlpmm_activate_profile (PpdDriver                    *driver,
     return ret;
 }
 
+static PpdProfile
+ppd_driver_tlpmm_query_state (PpdDriver *driver)
+{
+    PpdDriverTlpmm *tlpmm = PPD_DRIVER_TLPMM (driver);
+
+    /* Read from the backend's state on probe */
+    return tlpmm->activated_profile;
+}
+
 static void
 ppd_driver_tlpmm_finalize (GObject *object)
 {
@@ -270,6 +279,7 @@ ppd_driver_tlpmm_class_init (PpdDriverTlpmmClass *klass)
     driver_class = PPD_DRIVER_CLASS(klass);
     driver_class->probe = ppd_driver_tlpmm_probe;
     driver_class->activate_profile = ppd_driver_tlpmm_activate_profile;
+    driver_class->query_state = ppd_driver_tlpmm_query_state;
 }
 
 static void
@@ -263,6 +263,17 @@ gboolean ppd_driver_battery_changed (PpdDriver              *driver,
   return PPD_DRIVER_GET_CLASS (driver)->battery_changed (driver, val, error);
 }
 
+PpdProfile
+ppd_driver_query_state (PpdDriver *driver)
+{
+  g_return_val_if_fail (PPD_IS_DRIVER (driver), PPD_PROFILE_UNSET);
+
+  if (!PPD_DRIVER_GET_CLASS (driver)->query_state)
+    return PPD_PROFILE_UNSET;
+
+  return PPD_DRIVER_GET_CLASS (driver)->query_state (driver);
+}
+
 gboolean
 ppd_driver_prepare_to_sleep (PpdDriver  *driver,
                              gboolean    start,
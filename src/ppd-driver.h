@@ -47,6 +47,8 @@ typedef enum{
  * @activate_profile: Called by the daemon for every profile change.
  * @power_changed: Called by the daemon when power adapter status changes
  * @battery_changed: Called by the daemon when the battery level changes.
+ * @query_state: Called by the daemon on startup to know which profile the
+ *   hardware is already set to, if known. Returns %PPD_PROFILE_UNSET otherwise.
  *
  * New profile drivers should not derive from #PpdDriver.  They should
  * derive from the child from #PpdDriverCpu or #PpdDriverPlatform drivers
@@ -70,6 +72,7 @@ struct _PpdDriverClass
   gboolean       (* battery_changed)  (PpdDriver                   *driver,
                                        gdouble                      val,
                                        GError                     **error);
+  PpdProfile     (* query_state)      (PpdDriver                   *driver);
 };
 
 #ifndef __GTK_DOC_IGNORE__
@@ -79,6 +82,7 @@ gboolean ppd_driver_activate_profile (PpdDriver *driver,
 gboolean ppd_driver_power_changed (PpdDriver *driver, PpdPowerChangedReason reason, GError **error);
 gboolean ppd_driver_prepare_to_sleep (PpdDriver  *driver, gboolean start, GError **error);
 gboolean ppd_driver_battery_changed (PpdDriver *driver, gdouble val, GError **error);
+PpdProfile ppd_driver_query_state (PpdDriver *driver);
 const char *ppd_driver_get_driver_name (PpdDriver *driver);
 PpdProfile ppd_driver_get_profiles (PpdDriver *driver);
 const char *ppd_driver_get_performance_degraded (PpdDriver *driver);
@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) 2026 The power-profiles-daemon authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#define G_LOG_DOMAIN "Energy"
+
+#include <string.h>
+
+#include "power-profiles-daemon.h"
+#include "ppd-energy.h"
+#include "ppd-utils.h"
+#include "ppd-watchdog.h"
+
+#define POWERCAP_PATH "/sys/class/powercap"
+#define HWMON_PATH "/sys/class/hwmon"
+
+/* The RAPL counters wrap after a few minutes under full load, so they
+ * need to be read more often than that for a wrap to be detected */
+#define SAMPLE_INTERVAL 30
+
+typedef struct {
+  char *id;
+  char *name;
+  /* A counter in microjoules */
+  char *path;
+  /* The value the counter wraps at, or 0 if it does not */
+  guint64 max_range;
+  guint64 last;
+  gboolean has_last;
+  guint64 energy[NUM_PROFILES];
+} PpdEnergyDomain;
+
+struct _PpdEnergy {
+  GPtrArray *domains;
+  PpdProfile profile;
+  gint64 last_sample;
+  gint64 duration[NUM_PROFILES];
+  guint sample_id;
+};
+
+static void
+domain_free (PpdEnergyDomain *domain)
+{
+  g_free (domain->id);
+  g_free (domain->name);
+  g_free (domain->path);
+  g_free (domain);
+}
+
+static gboolean
+read_counter (const char  *path,
+              guint64     *value,
+              GError     **error)
+{
+  g_autofree char *contents = NULL;
+
+  if (!g_file_get_contents (path, &contents, NULL, error))
+    return FALSE;
+
+  return g_ascii_string_to_unsigned (g_strstrip (contents), 10, 0, G_MAXUINT64,
+                                     value, error);
+}
+
+static char *
+read_string (const char *dir,
+             const char *filename)
+{
+  g_autofree char *path = g_build_filename (dir, filename, NULL);
+  g_autofree char *contents = NULL;
+
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    return NULL;
+
+  return g_strdup (g_strstrip (contents));
+}
+
+static void
+add_domain (PpdEnergy  *energy,
+            const char *id,
+            const char *name,
+            const char *path,
+            guint64     max_range)
+{
+  g_autoptr(GError) error = NULL;
+  PpdEnergyDomain *domain;
+  guint64 value;
+
+  /* Reading the counters needs root since the PLATYPUS attack */
+  if (!read_counter (path, &value, &error)) {
+    g_debug ("Ignoring energy counter %s: %s", path, error->message);
+    return;
+  }
+
+  domain = g_new0 (PpdEnergyDomain, 1);
+  domain->id = g_strdup (id);
+  domain->name = g_strdup (name ? name : id);
+  domain->path = g_strdup (path);
+  domain->max_range = max_range;
+  domain->last = value;
+  domain->has_last = TRUE;
+  g_ptr_array_add (energy->domains, domain);
+
+  g_debug ("Found energy counter '%s' (%s)", domain->name, domain->id);
+}
+
+/* The RAPL zones, and their subzones, of the intel_rapl_msr and
+ * intel_rapl_mmio drivers, which also handle AMD processors */
+static void
+add_powercap_domains (PpdEnergy *energy)
+{
+  g_autofree char *class_path = ppd_utils_get_sysfs_path (POWERCAP_PATH);
+  g_autoptr(GDir) dir = NULL;
+  const char *entry;
+
+  dir = g_dir_open (class_path, 0, NULL);
+  if (dir == NULL)
+    return;
+
+  while ((entry = g_dir_read_name (dir)) != NULL) {
+    g_autofree char *zone = NULL;
+    g_autofree char *name = NULL;
+    g_autofree char *path = NULL;
+    g_autofree char *max_range = NULL;
+    guint64 max = 0;
+
+    /* Skips the "intel-rapl" control type, which is not a zone */
+    if (!g_str_has_prefix (entry, "intel-rapl") || !strchr (entry, ':'))
+      continue;
+
+    zone = g_build_filename (class_path, entry, NULL);
+    path = g_build_filename (zone, "energy_uj", NULL);
+    name = read_string (zone, "name");
+    max_range = read_string (zone, "max_energy_range_uj");
+    if (max_range)
+      g_ascii_string_to_unsigned (max_range, 10, 0, G_MAXUINT64, &max, NULL);
+
+    add_domain (energy, entry, name, path, max);
+  }
+}
+
+/* The per-socket counters of the amd_energy driver, which accumulates
+ * the hardware counters in 64 bits so that they do not wrap */
+static void
+add_amd_energy_domains (PpdEnergy *energy)
+{
+  g_autofree char *class_path = ppd_utils_get_sysfs_path (HWMON_PATH);
+  g_autoptr(GDir) dir = NULL;
+  const char *entry;
+
+  dir = g_dir_open (class_path, 0, NULL);
+  if (dir == NULL)
+    return;
+
+  while ((entry = g_dir_read_name (dir)) != NULL) {
+    g_autofree char *hwmon = g_build_filename (class_path, entry, NULL);
+    g_autofree char *driver = read_string (hwmon, "name");
+
+    if (g_strcmp0 (driver, "amd_energy") != 0)
+      continue;
+
+    for (guint i = 1; ; i++) {
+      g_autofree char *label_file = g_strdup_printf ("energy%u_label", i);
+      g_autofree char *input_file = g_strdup_printf ("energy%u_input", i);
+      g_autofree char *label = read_string (hwmon, label_file);
+      g_autofree char *id = NULL;
+      g_autofree char *path = NULL;
+
+      if (label == NULL)
+        break;
+      /* The per-core counters add up to part of the socket's */
+      if (!g_str_has_prefix (label, "Esocket"))
+        continue;
+
+      id = g_strdup_printf ("%s/energy%u", entry, i);
+      path = g_build_filename (hwmon, input_file, NULL);
+      add_domain (energy, id, label, path, 0);
+    }
+  }
+}
+
+static gint
+compare_domains (gconstpointer a,
+                 gconstpointer b)
+{
+  const PpdEnergyDomain *domain_a = *(const PpdEnergyDomain **) a;
+  const PpdEnergyDomain *domain_b = *(const PpdEnergyDomain **) b;
+
+  return g_strcmp0 (domain_a->id, domain_b->id);
+}
+
+static gboolean
+sample_timeout (gpointer user_data)
+{
+  ppd_energy_sample (user_data);
+  return G_SOURCE_CONTINUE;
+}
+
+PpdEnergy *
+ppd_energy_new (void)
+{
+  PpdEnergy *energy = g_new0 (PpdEnergy, 1);
+
+  energy->domains = g_ptr_array_new_with_free_func ((GDestroyNotify) domain_free);
+  add_powercap_domains (energy);
+  add_amd_energy_domains (energy);
+  g_ptr_array_sort (energy->domains, compare_domains);
+  energy->last_sample = g_get_monotonic_time ();
+
+  if (energy->domains->len == 0) {
+    g_debug ("No energy counters available");
+    return energy;
+  }
+
+  energy->sample_id = ppd_watchdog_timeout_add_seconds (SAMPLE_INTERVAL, "energy-sample",
+                                                       sample_timeout, energy);
+
+  return energy;
+}
+
+void
+ppd_energy_free (PpdEnergy *energy)
+{
+  if (energy == NULL)
+    return;
+
+  g_clear_handle_id (&energy->sample_id, g_source_remove);
+  g_ptr_array_unref (energy->domains);
+  g_free (energy);
+}
+
+guint
+ppd_energy_get_n_domains (PpdEnergy *energy)
+{
+  g_return_val_if_fail (energy != NULL, 0);
+
+  return energy->domains->len;
+}
+
+/* The energy used since the last reading, if it can be told */
+static guint64
+domain_sample (PpdEnergyDomain *domain)
+{
+  g_autoptr(GError) error = NULL;
+  guint64 value, delta = 0;
+
+  if (!read_counter (domain->path, &value, &error)) {
+    g_debug ("Could not read energy counter %s: %s", domain->path, error->message);
+    domain->has_last = FALSE;
+    return 0;
+  }
+
+  if (!domain->has_last)
+    delta = 0;
+  else if (value >= domain->last)
+    delta = value - domain->last;
+  else if (domain->max_range > domain->last)
+    delta = domain->max_range - domain->last + value;
+  else
+    g_debug ("Energy counter %s went backwards, ignoring the interval", domain->id);
+
+  domain->last = value;
+  domain->has_last = TRUE;
+
+  return delta;
+}
+
+void
+ppd_energy_sample (PpdEnergy *energy)
+{
+  gint64 now;
+  gint idx = -1;
+
+  g_return_if_fail (energy != NULL);
+
+  if (energy->profile != PPD_PROFILE_UNSET)
+    idx = g_bit_nth_lsf (energy->profile, -1);
+
+  for (guint i = 0; i < energy->domains->len; i++) {
+    PpdEnergyDomain *domain = g_ptr_array_index (energy->domains, i);
+    guint64 delta = domain_sample (domain);
+
+    if (idx >= 0)
+      domain->energy[idx] += delta;
+  }
+
+  now = g_get_monotonic_time ();
+  if (idx >= 0)
+    energy->duration[idx] += now - energy->last_sample;
+  energy->last_sample = now;
+}
+
+void
+ppd_energy_set_profile (PpdEnergy  *energy,
+                        PpdProfile  profile)
+{
+  g_return_if_fail (energy != NULL);
+  g_return_if_fail (ppd_profile_has_single_flag (profile));
+
+  if (energy->profile == profile)
+    return;
+
+  /* The energy used until now goes to the previous profile */
+  ppd_energy_sample (energy);
+  energy->profile = profile;
+}
+
+void
+ppd_energy_prepare_to_sleep (PpdEnergy *energy,
+                             gboolean   start)
+{
+  g_return_if_fail (energy != NULL);
+
+  if (start) {
+    ppd_energy_sample (energy);
+    return;
+  }
+
+  /* The counters might have been reset while suspended, which would
+   * look like a wrap, so start over from the current readings */
+  for (guint i = 0; i < energy->domains->len; i++) {
+    PpdEnergyDomain *domain = g_ptr_array_index (energy->domains, i);
+
+    domain->has_last = FALSE;
+  }
+  ppd_energy_sample (energy);
+}
+
+GVariant *
+ppd_energy_get_variant (PpdEnergy *energy)
+{
+  GVariantBuilder builder;
+  GVariantBuilder durations_builder;
+  GVariantBuilder domains_builder;
+
+  g_return_val_if_fail (energy != NULL, NULL);
+
+  ppd_energy_sample (energy);
+
+  g_variant_builder_init (&durations_builder, G_VARIANT_TYPE ("a{st}"));
+  for (guint i = 0; i < NUM_PROFILES; i++) {
+    if (energy->duration[i] == 0)
+      continue;
+    g_variant_builder_add (&durations_builder, "{st}",
+                           ppd_profile_to_str (1 << i), (guint64) energy->duration[i]);
+  }
+
+  g_variant_builder_init (&domains_builder, G_VARIANT_TYPE ("aa{sv}"));
+  for (guint i = 0; i < energy->domains->len; i++) {
+    PpdEnergyDomain *domain = g_ptr_array_index (energy->domains, i);
+    GVariantBuilder domain_builder;
+    GVariantBuilder energy_builder;
+
+    g_variant_builder_init (&energy_builder, G_VARIANT_TYPE ("a{st}"));
+    for (guint j = 0; j < NUM_PROFILES; j++) {
+      if (energy->duration[j] == 0)
+        continue;
+      g_variant_builder_add (&energy_builder, "{st}",
+                             ppd_profile_to_str (1 << j), domain->energy[j]);
+    }
+
+    g_variant_builder_init (&domain_builder, G_VARIANT_TYPE ("a{sv}"));
+    g_variant_builder_add (&domain_builder, "{sv}", "Id",
+                           g_variant_new_string (domain->id));
+    g_variant_builder_add (&domain_builder, "{sv}", "Name",
+                           g_variant_new_string (domain->name));
+    g_variant_builder_add (&domain_builder, "{sv}", "Energy",
+                           g_variant_builder_end (&energy_builder));
+    g_variant_builder_add (&domains_builder, "a{sv}", &domain_builder);
+  }
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+  g_variant_builder_add (&builder, "{sv}", "Durations",
+                         g_variant_builder_end (&durations_builder));
+  g_variant_builder_add (&builder, "{sv}", "Domains",
+                         g_variant_builder_end (&domains_builder));
+
+  return g_variant_builder_end (&builder);
+}
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2026 The power-profiles-daemon authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#pragma once
+
+#include <glib.h>
+#include "ppd-profile.h"
+
+typedef struct _PpdEnergy PpdEnergy;
+
+PpdEnergy *ppd_energy_new (void);
+void ppd_energy_free (PpdEnergy *energy);
+guint ppd_energy_get_n_domains (PpdEnergy *energy);
+void ppd_energy_sample (PpdEnergy *energy);
+void ppd_energy_set_profile (PpdEnergy  *energy,
+                             PpdProfile  profile);
+void ppd_energy_prepare_to_sleep (PpdEnergy *energy,
+                                  gboolean   start);
+GVariant *ppd_energy_get_variant (PpdEnergy *energy);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (PpdEnergy, ppd_energy_free)
@@ -0,0 +1,505 @@
+/*
+ * Copyright (c) 2026 The power-profiles-daemon authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#define G_LOG_DOMAIN "Metrics"
+
+#include <gio/gunixsocketaddress.h>
+
+#include "power-profiles-daemon.h"
+#include "ppd-metrics.h"
+
+#define NUM_REASONS (PPD_PROFILE_ACTIVATION_REASON_PROGRAM_HOLD + 1)
+#define MAX_REQUEST_SIZE 4096
+
+struct _PpdMetrics {
+  /* Updated from the main loop, read from the scrape threads */
+  GMutex lock;
+  PpdStats *stats;
+  PpdProfile profile;
+  gint64 profile_since;
+  gint64 profile_time[NUM_PROFILES];
+  guint64 switches[NUM_REASONS];
+  char *degraded;
+  GHashTable *holds;
+};
+
+/* The label that the keys of each stage's histograms are exported as */
+static const struct {
+  const char *stage;
+  const char *label;
+} stage_labels[] = {
+  { "request", "method" },
+  { "authorization", "action" },
+  { "activation", "reason" },
+  { "driver", "driver" },
+  { "action", "action" },
+  { "signal", "signal" },
+  { "persistence", "file" },
+  { "spawn", "program" },
+  { "spawn-error", "program" },
+  { "sysfs-write", "attribute" },
+  { "sysfs-write-error", "attribute" },
+  { "stall", "dispatch" },
+};
+
+/* The help text of each counter */
+static const struct {
+  const char *name;
+  const char *help;
+} counter_help[] = {
+  { "auth-cache-hits", "Authorization checks answered from the cache." },
+  { "auth-cache-misses", "Authorization checks that were not in the cache." },
+  { "config-saves-requested", "Configuration changes that needed saving." },
+  { "config-saves-written", "Configuration file writes." },
+  { "config-saves-merged", "Configuration saves merged into one already scheduled." },
+  { "config-saves-superseded", "Configuration writes skipped, as a newer one was done first." },
+};
+
+static void
+ppd_metrics_clear (PpdMetrics *metrics)
+{
+  g_mutex_clear (&metrics->lock);
+  ppd_stats_unref (metrics->stats);
+  g_free (metrics->degraded);
+  g_hash_table_unref (metrics->holds);
+}
+
+PpdMetrics *
+ppd_metrics_new (PpdStats *stats)
+{
+  PpdMetrics *metrics = g_atomic_rc_box_new0 (PpdMetrics);
+
+  g_mutex_init (&metrics->lock);
+  metrics->stats = ppd_stats_ref (stats);
+  metrics->degraded = g_strdup ("");
+  metrics->holds = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  return metrics;
+}
+
+PpdMetrics *
+ppd_metrics_ref (PpdMetrics *metrics)
+{
+  return g_atomic_rc_box_acquire (metrics);
+}
+
+void
+ppd_metrics_unref (PpdMetrics *metrics)
+{
+  g_atomic_rc_box_release_full (metrics, (GDestroyNotify) ppd_metrics_clear);
+}
+
+static void
+account_profile_time (PpdMetrics *metrics,
+                      gint64      now,
+                      gint64     *profile_time)
+{
+  if (metrics->profile == PPD_PROFILE_UNSET)
+    return;
+
+  profile_time[g_bit_nth_lsf (metrics->profile, -1)] += now - metrics->profile_since;
+}
+
+void
+ppd_metrics_set_profile (PpdMetrics *metrics,
+                         PpdProfile  profile)
+{
+  g_autoptr(GMutexLocker) locker = NULL;
+  gint64 now;
+
+  g_return_if_fail (metrics != NULL);
+  g_return_if_fail (ppd_profile_has_single_flag (profile));
+
+  locker = g_mutex_locker_new (&metrics->lock);
+  if (metrics->profile == profile)
+    return;
+
+  now = g_get_monotonic_time ();
+  account_profile_time (metrics, now, metrics->profile_time);
+  metrics->profile = profile;
+  metrics->profile_since = now;
+}
+
+void
+ppd_metrics_count_switch (PpdMetrics                 *metrics,
+                          PpdProfileActivationReason  reason)
+{
+  g_autoptr(GMutexLocker) locker = NULL;
+
+  g_return_if_fail (metrics != NULL);
+  g_return_if_fail (reason < NUM_REASONS);
+
+  locker = g_mutex_locker_new (&metrics->lock);
+  metrics->switches[reason]++;
+}
+
+void
+ppd_metrics_set_degraded (PpdMetrics *metrics,
+                          const char *degraded)
+{
+  g_autoptr(GMutexLocker) locker = NULL;
+
+  g_return_if_fail (metrics != NULL);
+
+  locker = g_mutex_locker_new (&metrics->lock);
+  g_free (metrics->degraded);
+  metrics->degraded = g_strdup (degraded ? degraded : "");
+}
+
+/* Adds @delta, which can be negative, to the holds of @application_id */
+void
+ppd_metrics_add_holds (PpdMetrics *metrics,
+                       const char *application_id,
+                       gint        delta)
+{
+  g_autoptr(GMutexLocker) locker = NULL;
+  gint count;
+
+  g_return_if_fail (metrics != NULL);
+
+  locker = g_mutex_locker_new (&metrics->lock);
+  count = GPOINTER_TO_UINT (g_hash_table_lookup (metrics->holds, application_id)) + delta;
+  if (count > 0)
+    g_hash_table_insert (metrics->holds, g_strdup (application_id), GUINT_TO_POINTER (count));
+  else
+    g_hash_table_remove (metrics->holds, application_id);
+}
+
+void
+ppd_metrics_clear_holds (PpdMetrics *metrics)
+{
+  g_autoptr(GMutexLocker) locker = NULL;
+
+  g_return_if_fail (metrics != NULL);
+
+  locker = g_mutex_locker_new (&metrics->lock);
+  g_hash_table_remove_all (metrics->holds);
+}
+
+static void
+append_label_value (GString    *str,
+                    const char *value)
+{
+  for (const char *p = value; *p != '\0'; p++) {
+    if (*p == '\\')
+      g_string_append (str, "\\\\");
+    else if (*p == '"')
+      g_string_append (str, "\\\"");
+    else if (*p == '\n')
+      g_string_append (str, "\\n");
+    else
+      g_string_append_c (str, *p);
+  }
+}
+
+static void
+append_seconds (GString *str,
+                gint64   usec)
+{
+  char buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_string_append (str, g_ascii_formatd (buf, sizeof (buf), "%.6f", usec / (double) G_USEC_PER_SEC));
+}
+
+static void
+append_family (GString    *str,
+               const char *name,
+               const char *type,
+               const char *unit,
+               const char *help)
+{
+  g_string_append_printf (str, "# TYPE %s %s\n", name, type);
+  if (unit)
+    g_string_append_printf (str, "# UNIT %s %s\n", name, unit);
+  g_string_append_printf (str, "# HELP %s %s\n", name, help);
+}
+
+static const char *
+get_stage_label (const char *stage)
+{
+  for (guint i = 0; i < G_N_ELEMENTS (stage_labels); i++) {
+    if (g_str_equal (stage_labels[i].stage, stage))
+      return stage_labels[i].label;
+  }
+  return "key";
+}
+
+static const char *
+get_counter_help (const char *name)
+{
+  for (guint i = 0; i < G_N_ELEMENTS (counter_help); i++) {
+    if (g_str_equal (counter_help[i].name, name))
+      return counter_help[i].help;
+  }
+  return "Number of events.";
+}
+
+static void
+append_counters (GString  *str,
+                 GVariant *statistics)
+{
+  g_autoptr(GVariant) counters = NULL;
+  GVariantIter iter;
+  const char *counter;
+  guint64 count;
+
+  counters = g_variant_lookup_value (statistics, "Counters", G_VARIANT_TYPE ("a{st}"));
+
+  g_variant_iter_init (&iter, counters);
+  while (g_variant_iter_next (&iter, "{&st}", &counter, &count)) {
+    g_autofree char *name = g_strdup_printf ("ppd_%s", counter);
+
+    g_strdelimit (name, "-", '_');
+    append_family (str, name, "counter", NULL, get_counter_help (counter));
+    g_string_append_printf (str, "%s_total %" G_GUINT64_FORMAT "\n", name, count);
+  }
+}
+
+static void
+append_histograms (GString  *str,
+                   GVariant *statistics)
+{
+  g_autoptr(GVariant) bounds_variant = NULL;
+  g_autoptr(GVariant) histograms = NULL;
+  g_autofree char *stage = NULL;
+  g_autofree char *name = NULL;
+  const guint64 *bounds;
+  gsize n_bounds;
+  GVariantIter iter;
+  GVariant *histogram;
+
+  bounds_variant = g_variant_lookup_value (statistics, "BucketBounds", G_VARIANT_TYPE ("at"));
+  histograms = g_variant_lookup_value (statistics, "Histograms", G_VARIANT_TYPE ("aa{sv}"));
+  bounds = g_variant_get_fixed_array (bounds_variant, &n_bounds, sizeof (guint64));
+
+  /* Histograms are sorted by stage, each stage is a metric family */
+  g_variant_iter_init (&iter, histograms);
+  while ((histogram = g_variant_iter_next_value (&iter)) != NULL) {
+    g_autoptr(GVariant) buckets_variant = NULL;
+    const guint64 *buckets;
+    const char *histogram_stage;
+    const char *key;
+    const char *label;
+    guint64 count, sum, cumulative = 0;
+    gsize n_buckets;
+
+    g_variant_lookup (histogram, "Stage", "&s", &histogram_stage);
+    g_variant_lookup (histogram, "Key", "&s", &key);
+    g_variant_lookup (histogram, "Count", "t", &count);
+    g_variant_lookup (histogram, "Sum", "t", &sum);
+    buckets_variant = g_variant_lookup_value (histogram, "Buckets", G_VARIANT_TYPE ("at"));
+    buckets = g_variant_get_fixed_array (buckets_variant, &n_buckets, sizeof (guint64));
+
+    if (g_strcmp0 (stage, histogram_stage) != 0) {
+      g_autofree char *help = NULL;
+
+      g_free (name);
+      name = g_strdup_printf ("ppd_%s_duration_seconds", histogram_stage);
+      g_strdelimit (name, "-", '_');
+      help = g_strdup_printf ("Time taken by the \"%s\" stage.", histogram_stage);
+      append_family (str, name, "histogram", "seconds", help);
+
+      /* Compared against the next histograms, after this one is gone */
+      g_free (stage);
+      stage = g_strdup (histogram_stage);
+    }
+    label = get_stage_label (stage);
+
+    for (gsize i = 0; i < n_buckets; i++) {
+      cumulative += buckets[i];
+      g_string_append_printf (str, "%s_bucket{%s=\"", name, label);
+      append_label_value (str, key);
+      g_string_append (str, "\",le=\"");
+      if (i < n_bounds)
+        append_seconds (str, bounds[i]);
+      else
+        g_string_append (str, "+Inf");
+      g_string_append_printf (str, "\"} %" G_GUINT64_FORMAT "\n", cumulative);
+    }
+    g_string_append_printf (str, "%s_count{%s=\"", name, label);
+    append_label_value (str, key);
+    g_string_append_printf (str, "\"} %" G_GUINT64_FORMAT "\n", count);
+    g_string_append_printf (str, "%s_sum{%s=\"", name, label);
+    append_label_value (str, key);
+    g_string_append (str, "\"} ");
+    append_seconds (str, sum);
+    g_string_append_c (str, '\n');
+
+    g_variant_unref (histogram);
+  }
+}
+
+char *
+ppd_metrics_to_string (PpdMetrics *metrics)
+{
+  g_autoptr(GVariant) statistics = NULL;
+  GString *str;
+
+  g_return_val_if_fail (metrics != NULL, NULL);
+
+  str = g_string_new (NULL);
+
+  {
+    g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&metrics->lock);
+    g_auto(GStrv) degraded = NULL;
+    gint64 profile_time[NUM_PROFILES];
+    GHashTableIter iter;
+    gpointer key, value;
+
+    append_family (str, "ppd_profile", "stateset", NULL, "The active power profile.");
+    for (guint i = 0; i < NUM_PROFILES; i++) {
+      g_string_append_printf (str, "ppd_profile{ppd_profile=\"%s\"} %d\n",
+                              ppd_profile_to_str (1 << i),
+                              metrics->profile == (1 << i));
+    }
+
+    memcpy (profile_time, metrics->profile_time, sizeof (profile_time));
+    account_profile_time (metrics, g_get_monotonic_time (), profile_time);
+    append_family (str, "ppd_profile_time_seconds", "counter", "seconds",
+                   "Time spent in each power profile.");
+    for (guint i = 0; i < NUM_PROFILES; i++) {
+      g_string_append_printf (str, "ppd_profile_time_seconds_total{profile=\"%s\"} ",
+                              ppd_profile_to_str (1 << i));
+      append_seconds (str, profile_time[i]);
+      g_string_append_c (str, '\n');
+    }
+
+    append_family (str, "ppd_profile_switches", "counter", NULL,
+                   "Power profile switches, by activation reason.");
+    for (guint i = 0; i < NUM_REASONS; i++) {
+      g_string_append_printf (str, "ppd_profile_switches_total{reason=\"%s\"} %" G_GUINT64_FORMAT "\n",
+                              ppd_profile_activation_reason_to_str (i),
+                              metrics->switches[i]);
+    }
+
+    append_family (str, "ppd_holds", "gauge", NULL, "Active profile holds, by application ID.");
+    g_hash_table_iter_init (&iter, metrics->holds);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+      g_string_append (str, "ppd_holds{application_id=\"");
+      append_label_value (str, key);
+      g_string_append_printf (str, "\"} %u\n", GPOINTER_TO_UINT (value));
+    }
+
+    append_family (str, "ppd_performance_degraded", "gauge", NULL,
+                   "Whether the performance profile is degraded, by reason.");
+    degraded = g_strsplit (metrics->degraded, ",", -1);
+    if (degraded[0] == NULL)
+      g_string_append (str, "ppd_performance_degraded 0\n");
+    for (guint i = 0; degraded[i] != NULL; i++) {
+      g_string_append (str, "ppd_performance_degraded{reason=\"");
+      append_label_value (str, degraded[i]);
+      g_string_append (str, "\"} 1\n");
+    }
+  }
+
+  statistics = ppd_stats_get_variant (metrics->stats);
+  append_counters (str, statistics);
+  append_histograms (str, statistics);
+
+  g_string_append (str, "# EOF\n");
+
+  return g_string_free (str, FALSE);
+}
+
+/* HTTP clients, such as curl --unix-socket, send a request first,
+ * plain ones like socat only read */
+static gboolean
+read_http_request (GSocketConnection *connection)
+{
+  GSocket *socket = g_socket_connection_get_socket (connection);
+  char buf[MAX_REQUEST_SIZE + 1];
+  gsize len = 0;
+
+  if (!g_socket_condition_timed_wait (socket, G_IO_IN, 100 * G_TIME_SPAN_MILLISECOND, NULL, NULL))
+    return FALSE;
+
+  g_socket_set_timeout (socket, 1);
+  while (len < MAX_REQUEST_SIZE) {
+    gssize ret;
+
+    ret = g_socket_receive (socket, buf + len, MAX_REQUEST_SIZE - len, NULL, NULL);
+    if (ret <= 0)
+      break;
+    len += ret;
+    buf[len] = '\0';
+    if (strstr (buf, "\r\n\r\n") != NULL)
+      break;
+  }
+  buf[len] = '\0';
+
+  return g_str_has_prefix (buf, "GET ");
+}
+
+static gboolean
+metrics_run_cb (GThreadedSocketService *service,
+                GSocketConnection      *connection,
+                GObject                *source_object,
+                gpointer                user_data)
+{
+  PpdMetrics *metrics = user_data;
+  GOutputStream *output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+  g_autoptr(GError) error = NULL;
+  g_autofree char *text = NULL;
+  gboolean http;
+
+  http = read_http_request (connection);
+  text = ppd_metrics_to_string (metrics);
+
+  if (http) {
+    g_autofree char *header = NULL;
+
+    header = g_strdup_printf ("HTTP/1.0 200 OK\r\n"
+                              "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                              "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+                              "\r\n",
+                              strlen (text));
+    if (!g_output_stream_write_all (output, header, strlen (header), NULL, NULL, &error)) {
+      g_debug ("Could not send metrics: %s", error->message);
+      return TRUE;
+    }
+  }
+
+  if (!g_output_stream_write_all (output, text, strlen (text), NULL, NULL, &error))
+    g_debug ("Could not send metrics: %s", error->message);
+
+  g_io_stream_close (G_IO_STREAM (connection), NULL, NULL);
+
+  return TRUE;
+}
+
+GSocketService *
+ppd_metrics_serve (PpdMetrics  *metrics,
+                   const char  *path,
+                   GError     **error)
+{
+  g_autoptr(GSocketService) service = NULL;
+  g_autoptr(GSocketAddress) address = NULL;
+
+  g_return_val_if_fail (metrics != NULL, NULL);
+  g_return_val_if_fail (path != NULL, NULL);
+
+  /* Scrapes are answered from their own threads, away from the main loop */
+  service = g_threaded_socket_service_new (2);
+  address = g_unix_socket_address_new (path);
+  if (!g_socket_listener_add_address (G_SOCKET_LISTENER (service),
+                                      address,
+                                      G_SOCKET_TYPE_STREAM,
+                                      G_SOCKET_PROTOCOL_DEFAULT,
+                                      NULL,
+                                      NULL,
+                                      error))
+    return NULL;
+
+  g_signal_connect_data (service, "run", G_CALLBACK (metrics_run_cb),
+                         ppd_metrics_ref (metrics),
+                         (GClosureNotify) ppd_metrics_unref, 0);
+  g_socket_service_start (service);
+
+  return g_steal_pointer (&service);
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2026 The power-profiles-daemon authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+#include "ppd-driver.h"
+#include "ppd-stats.h"
+
+typedef struct _PpdMetrics PpdMetrics;
+
+PpdMetrics *ppd_metrics_new (PpdStats *stats);
+PpdMetrics *ppd_metrics_ref (PpdMetrics *metrics);
+void ppd_metrics_unref (PpdMetrics *metrics);
+void ppd_metrics_set_profile (PpdMetrics *metrics,
+                              PpdProfile  profile);
+void ppd_metrics_count_switch (PpdMetrics                 *metrics,
+                               PpdProfileActivationReason  reason);
+void ppd_metrics_set_degraded (PpdMetrics *metrics,
+                               const char *degraded);
+void ppd_metrics_add_holds (PpdMetrics *metrics,
+                            const char *application_id,
+                            gint        delta);
+void ppd_metrics_clear_holds (PpdMetrics *metrics);
+char *ppd_metrics_to_string (PpdMetrics *metrics);
+GSocketService *ppd_metrics_serve (PpdMetrics  *metrics,
+                                   const char  *path,
+                                   GError     **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (PpdMetrics, ppd_metrics_unref)
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2026 The power-profiles-daemon authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#define G_LOG_DOMAIN "Modules"
+
+#include "config.h"
+
+#include <gmodule.h>
+
+#include "ppd-modules.h"
+#include "ppd-utils.h"
+
+#define MODULE_GROUP        "Module"
+#define PRECONDITIONS_GROUP "Preconditions"
+
+typedef GType (*PpdModuleGetTypeFunc) (void);
+
+typedef struct {
+  char *name;
+  char *library;
+  char *get_type;
+  gint priority;
+  GStrv paths;
+  GStrv cpu_vendors;
+  GStrv binaries;
+  GStrv environment;
+} PpdModuleManifest;
+
+static void
+manifest_free (PpdModuleManifest *manifest)
+{
+  if (manifest == NULL)
+    return;
+  g_free (manifest->name);
+  g_free (manifest->library);
+  g_free (manifest->get_type);
+  g_strfreev (manifest->paths);
+  g_strfreev (manifest->cpu_vendors);
+  g_strfreev (manifest->binaries);
+  g_strfreev (manifest->environment);
+  g_free (manifest);
+}
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (PpdModuleManifest, manifest_free)
+
+static PpdModuleManifest *
+manifest_load (const char  *path,
+               GError     **error)
+{
+  g_autoptr(GKeyFile) keyfile = g_key_file_new ();
+  g_autoptr(PpdModuleManifest) manifest = NULL;
+
+  if (!g_key_file_load_from_file (keyfile, path, G_KEY_FILE_NONE, error))
+    return NULL;
+
+  manifest = g_new0 (PpdModuleManifest, 1);
+  manifest->name = g_key_file_get_string (keyfile, MODULE_GROUP, "Name", error);
+  if (manifest->name == NULL)
+    return NULL;
+  manifest->library = g_key_file_get_string (keyfile, MODULE_GROUP, "Library", error);
+  if (manifest->library == NULL)
+    return NULL;
+  manifest->get_type = g_key_file_get_string (keyfile, MODULE_GROUP, "GetType", error);
+  if (manifest->get_type == NULL)
+    return NULL;
+  manifest->priority = g_key_file_get_integer (keyfile, MODULE_GROUP, "Priority", NULL);
+
+  /* All optional */
+  manifest->paths = g_key_file_get_string_list (keyfile, PRECONDITIONS_GROUP, "Paths", NULL, NULL);
+  manifest->cpu_vendors = g_key_file_get_string_list (keyfile, PRECONDITIONS_GROUP, "CpuVendor", NULL, NULL);
+  manifest->binaries = g_key_file_get_string_list (keyfile, PRECONDITIONS_GROUP, "Binaries", NULL, NULL);
+  manifest->environment = g_key_file_get_string_list (keyfile, PRECONDITIONS_GROUP, "Environment", NULL, NULL);
+
+  return g_steal_pointer (&manifest);
+}
+
+static gint
+manifest_compare (gconstpointer a,
+                  gconstpointer b)
+{
+  const PpdModuleManifest *manifest_a = *(PpdModuleManifest **) a;
+  const PpdModuleManifest *manifest_b = *(PpdModuleManifest **) b;
+
+  if (manifest_a->priority != manifest_b->priority)
+    return manifest_a->priority < manifest_b->priority ? -1 : 1;
+
+  return g_strcmp0 (manifest_a->name, manifest_b->name);
+}
+
+static gboolean
+manifest_preconditions_met (PpdModuleManifest *manifest)
+{
+  for (guint i = 0; manifest->environment && manifest->environment[i]; i++) {
+    if (g_getenv (manifest->environment[i]) == NULL) {
+      g_debug ("Module '%s' needs '%s' to be set", manifest->name, manifest->environment[i]);
+      return FALSE;
+    }
+  }
+
+  for (guint i = 0; manifest->paths && manifest->paths[i]; i++) {
+    g_autofree char *path = ppd_utils_get_sysfs_path (manifest->paths[i]);
+
+    if (!g_file_test (path, G_FILE_TEST_EXISTS)) {
+      g_debug ("Module '%s' needs '%s' to exist", manifest->name, path);
+      return FALSE;
+    }
+  }
+
+  for (guint i = 0; manifest->binaries && manifest->binaries[i]; i++) {
+    g_autofree char *program = g_find_program_in_path (manifest->binaries[i]);
+
+    if (program == NULL) {
+      g_debug ("Module '%s' needs '%s' to be installed", manifest->name, manifest->binaries[i]);
+      return FALSE;
+    }
+  }
+
+  if (manifest->cpu_vendors && manifest->cpu_vendors[0]) {
+    for (guint i = 0; manifest->cpu_vendors[i]; i++) {
+      if (ppd_utils_match_cpu_vendor (manifest->cpu_vendors[i]))
+        return TRUE;
+    }
+
+    g_debug ("Module '%s' does not support this CPU vendor", manifest->name);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static GType
+manifest_load_type (PpdModuleManifest *manifest,
+                    const char        *dir)
+{
+  g_autofree char *library_path = NULL;
+  PpdModuleGetTypeFunc get_type;
+  GModule *module;
+
+  library_path = g_build_filename (dir, manifest->library, NULL);
+  module = g_module_open (library_path, G_MODULE_BIND_LAZY | G_MODULE_BIND_LOCAL);
+  if (module == NULL) {
+    g_warning ("Could not load module '%s': %s", manifest->name, g_module_error ());
+    return G_TYPE_INVALID;
+  }
+
+  if (!g_module_symbol (module, manifest->get_type, (gpointer *) &get_type)) {
+    g_warning ("Module '%s' does not provide '%s': %s", manifest->name,
+               manifest->get_type, g_module_error ());
+    g_module_close (module);
+    return G_TYPE_INVALID;
+  }
+
+  /* Registered types can't go away */
+  g_module_make_resident (module);
+
+  return get_type ();
+}
+
+/* Appends the types of the modules usable on this machine, in priority order */
+void
+ppd_modules_load_types (const char *dir,
+                        GArray     *types)
+{
+  g_autoptr(GPtrArray) manifests = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GDir) modules_dir = NULL;
+  const char *filename;
+
+  modules_dir = g_dir_open (dir, 0, &error);
+  if (modules_dir == NULL) {
+    g_warning ("Could not list modules: %s", error->message);
+    return;
+  }
+
+  manifests = g_ptr_array_new_with_free_func ((GDestroyNotify) manifest_free);
+  while ((filename = g_dir_read_name (modules_dir)) != NULL) {
+    g_autofree char *path = NULL;
+    g_autoptr(GError) local_error = NULL;
+    PpdModuleManifest *manifest;
+
+    if (!g_str_has_suffix (filename, ".module"))
+      continue;
+
+    path = g_build_filename (dir, filename, NULL);
+    manifest = manifest_load (path, &local_error);
+    if (manifest == NULL) {
+      g_warning ("Invalid module manifest '%s': %s", path, local_error->message);
+      continue;
+    }
+    g_ptr_array_add (manifests, manifest);
+  }
+
+  g_ptr_array_sort (manifests, manifest_compare);
+
+  for (guint i = 0; i < manifests->len; i++) {
+    PpdModuleManifest *manifest = g_ptr_array_index (manifests, i);
+    GType type;
+
+    if (!manifest_preconditions_met (manifest))
+      continue;
+
+    type = manifest_load_type (manifest, dir);
+    if (type == G_TYPE_INVALID)
+      continue;
+
+    g_debug ("Loaded module '%s'", manifest->name);
+    g_array_append_val (types, type);
+  }
+}
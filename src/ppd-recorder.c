@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2026 The power-profiles-daemon authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#define G_LOG_DOMAIN "Recorder"
+
+#include "ppd-recorder.h"
+
+/* A power of two, so that the event counter can wrap */
+#define N_EVENTS 1024
+#define SUBJECT_SIZE 48
+#define DETAIL_SIZE 96
+
+/* The last N_EVENTS events, kept whatever the log level so that they can
+ * be looked at after the fact. Recording claims a slot and copies the
+ * event into it, without locking or allocating. Events are recorded and
+ * read from the main thread, so a slot is only ever torn if N_EVENTS
+ * events were recorded from other threads while it was being read. */
+typedef struct {
+  gint64 time;
+  gint64 value;
+  gint64 duration;
+  PpdEventType type;
+  PpdProfile profile;
+  char subject[SUBJECT_SIZE];
+  char detail[DETAIL_SIZE];
+} PpdEvent;
+
+static PpdEvent events[N_EVENTS];
+static gint n_events;
+
+static const struct {
+  const char *name;
+  gboolean has_value;
+  gboolean has_duration;
+} event_types[] = {
+  [PPD_EVENT_PROFILE] = { "profile", TRUE, TRUE },
+  [PPD_EVENT_HOLD] = { "hold", TRUE, FALSE },
+  [PPD_EVENT_RELEASE] = { "release", TRUE, FALSE },
+  [PPD_EVENT_POWER_SOURCE] = { "power-source", FALSE, FALSE },
+  [PPD_EVENT_BATTERY] = { "battery", TRUE, FALSE },
+  [PPD_EVENT_SUSPEND] = { "suspend", FALSE, FALSE },
+  [PPD_EVENT_RESUME] = { "resume", FALSE, FALSE },
+  [PPD_EVENT_DRIVER] = { "driver", TRUE, TRUE },
+  [PPD_EVENT_ACTION] = { "action", TRUE, TRUE },
+  [PPD_EVENT_SPAWN] = { "spawn", TRUE, TRUE },
+};
+
+static void
+copy_string (char       *dest,
+             const char *src,
+             gsize       size)
+{
+  gsize i;
+
+  if (src == NULL) {
+    dest[0] = '\0';
+    return;
+  }
+
+  /* Unlike g_strlcpy(), does not go through the rest of long strings */
+  for (i = 0; i < size - 1 && src[i] != '\0'; i++)
+    dest[i] = src[i];
+
+  /* Don't cut a UTF-8 character in two, as the string would not be
+   * valid anymore. A continuation byte was not copied, so drop the bytes
+   * of the same character before it. */
+  while (i > 0 && (src[i] & 0xC0) == 0x80)
+    i--;
+  dest[i] = '\0';
+}
+
+/* Program names and errors are not always valid UTF-8 to start with */
+static GVariant *
+new_string_variant (const char *str)
+{
+  if (g_utf8_validate (str, -1, NULL))
+    return g_variant_new_string (str);
+
+  return g_variant_new_take_string (g_utf8_make_valid (str, -1));
+}
+
+void
+ppd_recorder_record (PpdEventType  type,
+                     const char   *subject,
+                     PpdProfile    profile,
+                     gint64        value,
+                     gint64        duration,
+                     const char   *detail)
+{
+  PpdEvent *event;
+
+  g_return_if_fail (type < G_N_ELEMENTS (event_types));
+
+  event = &events[(guint) g_atomic_int_add (&n_events, 1) % N_EVENTS];
+  event->time = g_get_real_time ();
+  event->type = type;
+  event->profile = profile;
+  event->value = value;
+  event->duration = duration;
+  copy_string (event->subject, subject, SUBJECT_SIZE);
+  copy_string (event->detail, detail, DETAIL_SIZE);
+}
+
+/* Calls @func on the recorded events, oldest first */
+static void
+foreach_event (void     (*func) (const PpdEvent *event,
+                                 gpointer        user_data),
+               gpointer   user_data)
+{
+  guint count = (guint) g_atomic_int_get (&n_events);
+  guint first = count > N_EVENTS ? count - N_EVENTS : 0;
+
+  for (guint i = first; i != count; i++)
+    func (&events[i % N_EVENTS], user_data);
+}
+
+static void
+add_event_variant (const PpdEvent *event,
+                   gpointer        user_data)
+{
+  GVariantBuilder *builder = user_data;
+  GVariantBuilder event_builder;
+
+  g_variant_builder_init (&event_builder, G_VARIANT_TYPE ("a{sv}"));
+  g_variant_builder_add (&event_builder, "{sv}", "Time",
+                         g_variant_new_int64 (event->time));
+  g_variant_builder_add (&event_builder, "{sv}", "Type",
+                         g_variant_new_string (event_types[event->type].name));
+  if (*event->subject != '\0')
+    g_variant_builder_add (&event_builder, "{sv}", "Subject",
+                           new_string_variant (event->subject));
+  if (event->profile != PPD_PROFILE_UNSET)
+    g_variant_builder_add (&event_builder, "{sv}", "Profile",
+                           g_variant_new_string (ppd_profile_to_str (event->profile)));
+  if (event_types[event->type].has_value)
+    g_variant_builder_add (&event_builder, "{sv}", "Value",
+                           g_variant_new_int64 (event->value));
+  if (event_types[event->type].has_duration)
+    g_variant_builder_add (&event_builder, "{sv}", "Duration",
+                           g_variant_new_uint64 (event->duration));
+  if (*event->detail != '\0')
+    g_variant_builder_add (&event_builder, "{sv}", "Detail",
+                           new_string_variant (event->detail));
+  g_variant_builder_add (builder, "a{sv}", &event_builder);
+}
+
+GVariant *
+ppd_recorder_get_variant (void)
+{
+  GVariantBuilder builder;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+  foreach_event (add_event_variant, &builder);
+
+  return g_variant_builder_end (&builder);
+}
+
+static void
+log_event (const PpdEvent *event,
+           gpointer        user_data)
+{
+  g_autoptr(GDateTime) seconds = NULL;
+  g_autoptr(GDateTime) date = NULL;
+  g_autoptr(GString) line = g_string_new (NULL);
+  g_autofree char *timestamp = NULL;
+
+  seconds = g_date_time_new_from_unix_local (event->time / G_USEC_PER_SEC);
+  date = g_date_time_add (seconds, event->time % G_USEC_PER_SEC);
+  timestamp = g_date_time_format (date, "%F %T.%f");
+  g_string_append_printf (line, "%s %s", timestamp, event_types[event->type].name);
+  if (*event->subject != '\0')
+    g_string_append_printf (line, " %s", event->subject);
+  if (event->profile != PPD_PROFILE_UNSET)
+    g_string_append_printf (line, " profile=%s", ppd_profile_to_str (event->profile));
+  if (event_types[event->type].has_value)
+    g_string_append_printf (line, " value=%" G_GINT64_FORMAT, event->value);
+  if (event_types[event->type].has_duration)
+    g_string_append_printf (line, " duration=%" G_GINT64_FORMAT "us", event->duration);
+  if (*event->detail != '\0')
+    g_string_append_printf (line, " (%s)", event->detail);
+
+  g_message ("%s", line->str);
+}
+
+void
+ppd_recorder_dump (void)
+{
+  guint count = (guint) g_atomic_int_get (&n_events);
+
+  g_message ("Dumping the last %u of %u recorded events", MIN (count, N_EVENTS), count);
+  foreach_event (log_event, NULL);
+}
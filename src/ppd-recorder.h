@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2026 The power-profiles-daemon authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#pragma once
+
+#include <glib.h>
+#include "ppd-profile.h"
+
+/**
+ * PpdEventType:
+ * @PPD_EVENT_PROFILE: a profile switch, with the activation reason as
+ *   subject, the target profile, whether it succeeded as value, its
+ *   duration, and the error as detail
+ * @PPD_EVENT_HOLD: a profile hold, with the application ID as subject,
+ *   the profile, the cookie as value and the reason as detail
+ * @PPD_EVENT_RELEASE: a profile hold being released, with the application
+ *   ID as subject, the profile and the cookie as value
+ * @PPD_EVENT_POWER_SOURCE: UPower reporting a change of power source, as
+ *   subject
+ * @PPD_EVENT_BATTERY: UPower reporting a new battery level, in percent,
+ *   as value
+ * @PPD_EVENT_SUSPEND: the system going to sleep
+ * @PPD_EVENT_RESUME: the system waking up
+ * @PPD_EVENT_DRIVER: a driver activating a profile, with the driver name as
+ *   subject, the profile, whether it succeeded as value, its duration, and
+ *   the error as detail
+ * @PPD_EVENT_ACTION: the same, for an action
+ * @PPD_EVENT_SPAWN: a backend command, with the program as subject, its wait
+ *   status as value, or -1 if it could not be run, its duration, and the
+ *   error as detail
+ *
+ * The events kept by the flight recorder.
+ */
+typedef enum {
+  PPD_EVENT_PROFILE,
+  PPD_EVENT_HOLD,
+  PPD_EVENT_RELEASE,
+  PPD_EVENT_POWER_SOURCE,
+  PPD_EVENT_BATTERY,
+  PPD_EVENT_SUSPEND,
+  PPD_EVENT_RESUME,
+  PPD_EVENT_DRIVER,
+  PPD_EVENT_ACTION,
+  PPD_EVENT_SPAWN,
+} PpdEventType;
+
+void ppd_recorder_record (PpdEventType  type,
+                          const char   *subject,
+                          PpdProfile    profile,
+                          gint64        value,
+                          gint64        duration,
+                          const char   *detail);
+GVariant *ppd_recorder_get_variant (void);
+void ppd_recorder_dump (void);
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2026 The power-profiles-daemon authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#define G_LOG_DOMAIN "Stats"
+
+#include "ppd-stats.h"
+
+/* Upper bounds of the histogram buckets, in microseconds, the last
+ * bucket holds everything slower */
+static const guint64 bucket_bounds[] = {
+  100, 250, 500,
+  1000, 2500, 5000,
+  10000, 25000, 50000,
+  100000, 250000, 500000,
+  1000000, 2500000, 5000000,
+};
+
+#define N_BUCKETS (G_N_ELEMENTS (bucket_bounds) + 1)
+
+typedef struct {
+  char *stage;
+  char *key;
+  guint64 count;
+  guint64 sum;
+  guint64 max;
+  guint64 buckets[N_BUCKETS];
+} PpdHistogram;
+
+struct _PpdStats {
+  /* Recorded from the state file writer thread too */
+  GMutex lock;
+  GHashTable *histograms;
+  /* Event counts, by name */
+  GHashTable *counters;
+};
+
+static void
+histogram_free (PpdHistogram *histogram)
+{
+  g_free (histogram->stage);
+  g_free (histogram->key);
+  g_free (histogram);
+}
+
+static void
+ppd_stats_clear (PpdStats *stats)
+{
+  g_mutex_clear (&stats->lock);
+  g_hash_table_unref (stats->histograms);
+  g_hash_table_unref (stats->counters);
+}
+
+PpdStats *
+ppd_stats_new (void)
+{
+  PpdStats *stats = g_atomic_rc_box_new0 (PpdStats);
+
+  g_mutex_init (&stats->lock);
+  stats->histograms = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                             (GDestroyNotify) histogram_free);
+  stats->counters = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  return stats;
+}
+
+/* Shared with the helpers in ppd-utils.c, which have no daemon to hand */
+PpdStats *
+ppd_stats_get_default (void)
+{
+  static PpdStats *default_stats = NULL;
+
+  if (g_once_init_enter (&default_stats))
+    g_once_init_leave (&default_stats, ppd_stats_new ());
+
+  return default_stats;
+}
+
+PpdStats *
+ppd_stats_ref (PpdStats *stats)
+{
+  return g_atomic_rc_box_acquire (stats);
+}
+
+void
+ppd_stats_unref (PpdStats *stats)
+{
+  g_atomic_rc_box_release_full (stats, (GDestroyNotify) ppd_stats_clear);
+}
+
+void
+ppd_stats_record (PpdStats   *stats,
+                  const char *stage,
+                  const char *key,
+                  gint64      duration)
+{
+  g_autoptr(GMutexLocker) locker = NULL;
+  g_autofree char *id = NULL;
+  PpdHistogram *histogram;
+  guint64 value;
+  guint bucket;
+
+  g_return_if_fail (stats != NULL);
+  g_return_if_fail (stage != NULL);
+
+  if (key == NULL)
+    key = "";
+  value = MAX (duration, 0);
+
+  for (bucket = 0; bucket < G_N_ELEMENTS (bucket_bounds); bucket++) {
+    if (value <= bucket_bounds[bucket])
+      break;
+  }
+
+  id = g_strdup_printf ("%s\t%s", stage, key);
+  locker = g_mutex_locker_new (&stats->lock);
+
+  histogram = g_hash_table_lookup (stats->histograms, id);
+  if (histogram == NULL) {
+    histogram = g_new0 (PpdHistogram, 1);
+    histogram->stage = g_strdup (stage);
+    histogram->key = g_strdup (key);
+    g_hash_table_insert (stats->histograms, g_steal_pointer (&id), histogram);
+  }
+
+  histogram->count++;
+  histogram->sum += value;
+  histogram->max = MAX (histogram->max, value);
+  histogram->buckets[bucket]++;
+}
+
+void
+ppd_stats_count (PpdStats   *stats,
+                 const char *name)
+{
+  g_autoptr(GMutexLocker) locker = NULL;
+  guint64 *count;
+
+  g_return_if_fail (stats != NULL);
+  g_return_if_fail (name != NULL);
+
+  locker = g_mutex_locker_new (&stats->lock);
+  count = g_hash_table_lookup (stats->counters, name);
+  if (count == NULL) {
+    count = g_new0 (guint64, 1);
+    g_hash_table_insert (stats->counters, g_strdup (name), count);
+  }
+  (*count)++;
+}
+
+guint64
+ppd_stats_get_count (PpdStats   *stats,
+                     const char *name)
+{
+  g_autoptr(GMutexLocker) locker = NULL;
+  guint64 *count;
+
+  g_return_val_if_fail (stats != NULL, 0);
+  g_return_val_if_fail (name != NULL, 0);
+
+  locker = g_mutex_locker_new (&stats->lock);
+  count = g_hash_table_lookup (stats->counters, name);
+
+  return count ? *count : 0;
+}
+
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return g_strcmp0 (*(const char **) a, *(const char **) b);
+}
+
+static gint
+compare_histograms (gconstpointer a,
+                    gconstpointer b)
+{
+  const PpdHistogram *histogram_a = *(PpdHistogram **) a;
+  const PpdHistogram *histogram_b = *(PpdHistogram **) b;
+  gint ret;
+
+  ret = g_strcmp0 (histogram_a->stage, histogram_b->stage);
+  if (ret != 0)
+    return ret;
+
+  return g_strcmp0 (histogram_a->key, histogram_b->key);
+}
+
+GVariant *
+ppd_stats_get_variant (PpdStats *stats)
+{
+  g_autoptr(GMutexLocker) locker = NULL;
+  g_autoptr(GPtrArray) histograms = NULL;
+  g_autoptr(GPtrArray) counter_names = NULL;
+  GVariantBuilder builder;
+  GVariantBuilder histograms_builder;
+  GVariantBuilder counters_builder;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_return_val_if_fail (stats != NULL, NULL);
+
+  locker = g_mutex_locker_new (&stats->lock);
+
+  histograms = g_ptr_array_new ();
+  g_hash_table_iter_init (&iter, stats->histograms);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    g_ptr_array_add (histograms, value);
+  g_ptr_array_sort (histograms, compare_histograms);
+
+  g_variant_builder_init (&histograms_builder, G_VARIANT_TYPE ("aa{sv}"));
+  for (guint i = 0; i < histograms->len; i++) {
+    PpdHistogram *histogram = g_ptr_array_index (histograms, i);
+    GVariantBuilder histogram_builder;
+
+    g_variant_builder_init (&histogram_builder, G_VARIANT_TYPE ("a{sv}"));
+    g_variant_builder_add (&histogram_builder, "{sv}", "Stage",
+                           g_variant_new_string (histogram->stage));
+    g_variant_builder_add (&histogram_builder, "{sv}", "Key",
+                           g_variant_new_string (histogram->key));
+    g_variant_builder_add (&histogram_builder, "{sv}", "Count",
+                           g_variant_new_uint64 (histogram->count));
+    g_variant_builder_add (&histogram_builder, "{sv}", "Sum",
+                           g_variant_new_uint64 (histogram->sum));
+    g_variant_builder_add (&histogram_builder, "{sv}", "Max",
+                           g_variant_new_uint64 (histogram->max));
+    g_variant_builder_add (&histogram_builder, "{sv}", "Buckets",
+                           g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64,
+                                                      histogram->buckets,
+                                                      N_BUCKETS,
+                                                      sizeof (guint64)));
+    g_variant_builder_add (&histograms_builder, "a{sv}", &histogram_builder);
+  }
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+  g_variant_builder_add (&builder, "{sv}", "BucketBounds",
+                         g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64,
+                                                    bucket_bounds,
+                                                    G_N_ELEMENTS (bucket_bounds),
+                                                    sizeof (guint64)));
+  g_variant_builder_add (&builder, "{sv}", "Histograms",
+                         g_variant_builder_end (&histograms_builder));
+
+  counter_names = g_ptr_array_new ();
+  g_hash_table_iter_init (&iter, stats->counters);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    g_ptr_array_add (counter_names, key);
+  g_ptr_array_sort (counter_names, compare_strings);
+
+  g_variant_builder_init (&counters_builder, G_VARIANT_TYPE ("a{st}"));
+  for (guint i = 0; i < counter_names->len; i++) {
+    const char *name = g_ptr_array_index (counter_names, i);
+    guint64 *count = g_hash_table_lookup (stats->counters, name);
+
+    g_variant_builder_add (&counters_builder, "{st}", name, *count);
+  }
+  g_variant_builder_add (&builder, "{sv}", "Counters",
+                         g_variant_builder_end (&counters_builder));
+
+  return g_variant_builder_end (&builder);
+}
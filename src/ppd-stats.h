@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2026 The power-profiles-daemon authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#pragma once
+
+#include <glib.h>
+
+typedef struct _PpdStats PpdStats;
+
+PpdStats *ppd_stats_new (void);
+PpdStats *ppd_stats_get_default (void);
+PpdStats *ppd_stats_ref (PpdStats *stats);
+void ppd_stats_unref (PpdStats *stats);
+void ppd_stats_record (PpdStats   *stats,
+                       const char *stage,
+                       const char *key,
+                       gint64      duration);
+void ppd_stats_count (PpdStats   *stats,
+                      const char *name);
+guint64 ppd_stats_get_count (PpdStats   *stats,
+                             const char *name);
+GVariant *ppd_stats_get_variant (PpdStats *stats);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (PpdStats, ppd_stats_unref)
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2026 The power-profiles-daemon authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#pragma once
+
+#include "config.h"
+
+/* Static tracepoints for SystemTap, bpftrace and other USDT consumers,
+ * under the "ppd" provider. A disabled probe is a single nop, but its
+ * arguments are still evaluated, so only pass values that are already
+ * at hand. See contrib/bpftrace/ for examples. */
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define PPD_TRACE(name) DTRACE_PROBE (ppd, name)
+#define PPD_TRACE1(name, a) DTRACE_PROBE1 (ppd, name, a)
+#define PPD_TRACE2(name, a, b) DTRACE_PROBE2 (ppd, name, a, b)
+#define PPD_TRACE3(name, a, b, c) DTRACE_PROBE3 (ppd, name, a, b, c)
+#else
+#define PPD_TRACE(name) do { } while (0)
+#define PPD_TRACE1(name, a) do { } while (0)
+#define PPD_TRACE2(name, a, b) do { } while (0)
+#define PPD_TRACE3(name, a, b, c) do { } while (0)
+#endif
@@ -10,11 +10,15 @@
 #define G_LOG_DOMAIN "Utils"
 
 #include "ppd-utils.h"
+#include "ppd-recorder.h"
+#include "ppd-stats.h"
+#include "ppd-trace.h"
 #include <glib/gstdio.h>
 #include <gio/gio.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <errno.h>
+#include <sys/wait.h>
 
 #define PROC_CPUINFO_PATH      "/proc/cpuinfo"
 
@@ -30,10 +34,10 @@ ppd_utils_get_sysfs_path (const char *filename)
   return g_build_filename (root, filename, NULL);
 }
 
-gboolean
-ppd_utils_write (const char  *filename,
-                 const char  *value,
-                 GError     **error)
+static gboolean
+write_value (const char  *filename,
+             const char  *value,
+             GError     **error)
 {
 #if GLIB_CHECK_VERSION (2, 76, 0)
   g_autofd
@@ -45,12 +49,14 @@ ppd_utils_write (const char  *filename,
   g_return_val_if_fail (value, FALSE);
 
   g_debug ("Writing '%s' to '%s'", value, filename);
+  PPD_TRACE2 (write_start, filename, value);
 
   fd = g_open (filename, O_WRONLY | O_TRUNC | O_SYNC);
   if (fd == -1) {
     g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
                  "Could not open '%s' for writing", filename);
     g_debug ("Could not open for writing '%s'", filename);
+    PPD_TRACE2 (write_done, filename, errno);
     return FALSE;
   }
 
@@ -62,6 +68,7 @@ ppd_utils_write (const char  *filename,
       g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
                    "Error writing '%s': %s", filename, g_strerror (errno));
       g_debug ("Error writing '%s': %s", filename, g_strerror (errno));
+      PPD_TRACE2 (write_done, filename, errno);
 #if !GLIB_CHECK_VERSION (2, 76, 0)
       g_close (fd, NULL);
 #endif
@@ -75,10 +82,31 @@ ppd_utils_write (const char  *filename,
 #if !GLIB_CHECK_VERSION (2, 76, 0)
   g_close (fd, NULL);
 #endif
+  PPD_TRACE2 (write_done, filename, 0);
 
   return TRUE;
 }
 
+gboolean
+ppd_utils_write (const char  *filename,
+                 const char  *value,
+                 GError     **error)
+{
+  g_autofree char *attribute = NULL;
+  gint64 start = g_get_monotonic_time ();
+  gboolean ret;
+
+  g_return_val_if_fail (filename, FALSE);
+
+  ret = write_value (filename, value, error);
+
+  attribute = g_path_get_basename (filename);
+  ppd_stats_record (ppd_stats_get_default (), ret ? "sysfs-write" : "sysfs-write-error",
+                    attribute, g_get_monotonic_time () - start);
+
+  return ret;
+}
+
 gboolean
 ppd_utils_write_files (GPtrArray   *filenames,
                        const char  *value,
@@ -96,6 +124,42 @@ ppd_utils_write_files (GPtrArray   *filenames,
   return TRUE;
 }
 
+gboolean
+ppd_utils_spawn_command_line_sync (const char  *command_line,
+                                   char       **standard_output,
+                                   char       **standard_error,
+                                   int         *wait_status,
+                                   GError     **error)
+{
+  g_autofree char *program = NULL;
+  int status = 0;
+  gint64 start;
+  gboolean ret;
+
+  g_return_val_if_fail (command_line != NULL, FALSE);
+
+  start = g_get_monotonic_time ();
+  PPD_TRACE1 (spawn_start, command_line);
+  ret = g_spawn_command_line_sync (command_line, standard_output, standard_error,
+                                   &status, error);
+  PPD_TRACE3 (spawn_done, command_line, ret, status);
+
+  /* Keyed by program, the arguments vary */
+  program = g_strndup (command_line, strcspn (command_line, " "));
+  ppd_stats_record (ppd_stats_get_default (),
+                    ret && WIFEXITED (status) && WEXITSTATUS (status) == 0 ? "spawn" : "spawn-error",
+                    program, g_get_monotonic_time () - start);
+  ppd_recorder_record (PPD_EVENT_SPAWN, program, PPD_PROFILE_UNSET, ret ? status : -1,
+                       g_get_monotonic_time () - start,
+                       !ret && error && *error ? (*error)->message : NULL);
+
+  if (wait_status)
+    *wait_status = status;
+
+  return ret;
+}
+
+#ifdef HAVE_GUDEV
 gboolean ppd_utils_write_sysfs (GUdevDevice  *device,
                                 const char   *attribute,
                                 const char   *value,
@@ -171,6 +235,7 @@ ppd_utils_find_device (const char   *subsystem,
 
   return ret;
 }
+#endif
 
 gboolean
 ppd_utils_match_cpu_vendor (const char *vendor)
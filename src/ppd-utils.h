@@ -9,7 +9,11 @@
 
 #pragma once
 
+#include "config.h"
+
+#ifdef HAVE_GUDEV
 #include <gudev/gudev.h>
+#endif
 #include <gio/gio.h>
 
 char * ppd_utils_get_sysfs_path (const char *filename);
@@ -19,6 +23,12 @@ gboolean ppd_utils_write (const char  *filename,
 gboolean ppd_utils_write_files (GPtrArray   *filenames,
                                 const char  *value,
                                 GError     **error);
+gboolean ppd_utils_spawn_command_line_sync (const char  *command_line,
+                                            char       **standard_output,
+                                            char       **standard_error,
+                                            int         *wait_status,
+                                            GError     **error);
+#ifdef HAVE_GUDEV
 gboolean ppd_utils_write_sysfs (GUdevDevice  *device,
                                 const char   *attribute,
                                 const char   *value,
@@ -33,4 +43,5 @@ GFileMonitor *ppd_utils_monitor_sysfs_attr (GUdevDevice  *device,
 GUdevDevice *ppd_utils_find_device (const char   *subsystem,
                                     GCompareFunc  func,
                                     gpointer      user_data);
+#endif
 gboolean ppd_utils_match_cpu_vendor (const char *vendor);
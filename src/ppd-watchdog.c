@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2026 The power-profiles-daemon authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#define G_LOG_DOMAIN "Watchdog"
+
+#include <glib-unix.h>
+
+#include "ppd-stats.h"
+#include "ppd-watchdog.h"
+
+#define N_WORST_STALLS 10
+#define DISPATCH_SIZE 64
+
+typedef struct {
+  char dispatch[DISPATCH_SIZE];
+  gint64 duration;
+  gint64 time;
+} PpdStall;
+
+/* The main thread is busy from the moment poll() returns until it is
+ * called again. A thread checks that this does not last longer than the
+ * threshold, and blames the last dispatch that was entered. */
+static struct {
+  GMutex lock;
+  GCond cond;
+  GThread *thread;
+  gboolean running;
+  gint64 threshold;
+  GPollFunc poll_func;
+
+  gboolean busy;
+  gint64 busy_since;
+  /* The thread sleeps without a timeout while the main loop polls */
+  gboolean sleeping;
+  guint depth;
+  char dispatch[DISPATCH_SIZE];
+
+  gboolean stalled;
+  char stall_dispatch[DISPATCH_SIZE];
+  PpdStall worst[N_WORST_STALLS];
+  guint n_worst;
+} watchdog;
+
+typedef struct {
+  const char *name;
+  GSourceFunc func;
+  gpointer user_data;
+} WatchedSource;
+
+/* Called with the lock held */
+static void
+add_worst_stall (const char *dispatch,
+                 gint64      duration,
+                 gint64      time)
+{
+  guint i = MIN (watchdog.n_worst, N_WORST_STALLS - 1);
+
+  if (i == N_WORST_STALLS - 1 && watchdog.worst[i].duration >= duration)
+    return;
+
+  /* Sorted longest first, the shortest is dropped when full */
+  for (; i > 0 && watchdog.worst[i - 1].duration < duration; i--)
+    watchdog.worst[i] = watchdog.worst[i - 1];
+
+  g_strlcpy (watchdog.worst[i].dispatch, dispatch, DISPATCH_SIZE);
+  watchdog.worst[i].duration = duration;
+  watchdog.worst[i].time = time;
+  watchdog.n_worst = MIN (watchdog.n_worst + 1, N_WORST_STALLS);
+}
+
+static gint
+watchdog_poll (GPollFD *fds,
+               guint    nfds,
+               gint     timeout)
+{
+  char dispatch[DISPATCH_SIZE] = { 0 };
+  gint64 duration = 0;
+  gint ret;
+
+  g_mutex_lock (&watchdog.lock);
+  if (watchdog.stalled) {
+    gint64 now = g_get_monotonic_time ();
+
+    duration = now - watchdog.busy_since;
+    g_strlcpy (dispatch, watchdog.stall_dispatch, DISPATCH_SIZE);
+    add_worst_stall (dispatch, duration, g_get_real_time () - duration);
+    watchdog.stalled = FALSE;
+  }
+  watchdog.busy = FALSE;
+  g_mutex_unlock (&watchdog.lock);
+
+  if (duration > 0) {
+    g_message ("Main loop was stalled for %" G_GINT64_FORMAT " ms in %s",
+               duration / 1000, dispatch);
+    ppd_stats_record (ppd_stats_get_default (), "stall", dispatch, duration);
+  }
+
+  ret = watchdog.poll_func (fds, nfds, timeout);
+
+  g_mutex_lock (&watchdog.lock);
+  watchdog.busy = TRUE;
+  watchdog.busy_since = g_get_monotonic_time ();
+  *watchdog.dispatch = '\0';
+  if (watchdog.sleeping)
+    g_cond_signal (&watchdog.cond);
+  g_mutex_unlock (&watchdog.lock);
+
+  return ret;
+}
+
+static gpointer
+watchdog_thread (gpointer user_data)
+{
+  g_mutex_lock (&watchdog.lock);
+
+  while (watchdog.running) {
+    gint64 now = g_get_monotonic_time ();
+
+    if (watchdog.busy && !watchdog.stalled &&
+        now - watchdog.busy_since >= watchdog.threshold) {
+      char dispatch[DISPATCH_SIZE];
+      gint64 busy_since = watchdog.busy_since;
+
+      watchdog.stalled = TRUE;
+      g_strlcpy (watchdog.stall_dispatch,
+                 *watchdog.dispatch ? watchdog.dispatch : "unknown", DISPATCH_SIZE);
+      g_strlcpy (dispatch, watchdog.stall_dispatch, DISPATCH_SIZE);
+
+      /* The main thread could be stuck for good, say so now */
+      g_mutex_unlock (&watchdog.lock);
+      g_warning ("Main loop blocked for %" G_GINT64_FORMAT " ms in %s",
+                 (now - busy_since) / 1000, dispatch);
+      g_mutex_lock (&watchdog.lock);
+      continue;
+    }
+
+    /* Nothing can stall while the main loop is idle, or once a stall was
+     * reported, so only wake up when a dispatch would reach the threshold */
+    if (!watchdog.busy || watchdog.stalled) {
+      watchdog.sleeping = TRUE;
+      g_cond_wait (&watchdog.cond, &watchdog.lock);
+      watchdog.sleeping = FALSE;
+    } else {
+      g_cond_wait_until (&watchdog.cond, &watchdog.lock,
+                         watchdog.busy_since + watchdog.threshold);
+    }
+  }
+
+  g_mutex_unlock (&watchdog.lock);
+
+  return NULL;
+}
+
+gboolean
+ppd_watchdog_start (gint64   threshold,
+                    GError **error)
+{
+  g_return_val_if_fail (watchdog.thread == NULL, FALSE);
+  g_return_val_if_fail (threshold > 0, FALSE);
+
+  g_mutex_lock (&watchdog.lock);
+  watchdog.threshold = threshold;
+  watchdog.running = TRUE;
+  watchdog.busy = TRUE;
+  watchdog.busy_since = g_get_monotonic_time ();
+  g_mutex_unlock (&watchdog.lock);
+
+  watchdog.poll_func = g_main_context_get_poll_func (NULL);
+  g_main_context_set_poll_func (NULL, watchdog_poll);
+
+  watchdog.thread = g_thread_try_new ("ppd-watchdog", watchdog_thread, NULL, error);
+  if (watchdog.thread == NULL) {
+    g_main_context_set_poll_func (NULL, watchdog.poll_func);
+    watchdog.running = FALSE;
+    return FALSE;
+  }
+
+  g_debug ("Watching for main loop stalls of more than %" G_GINT64_FORMAT " ms",
+           threshold / 1000);
+
+  return TRUE;
+}
+
+void
+ppd_watchdog_stop (void)
+{
+  if (watchdog.thread == NULL)
+    return;
+
+  g_mutex_lock (&watchdog.lock);
+  watchdog.running = FALSE;
+  g_cond_signal (&watchdog.cond);
+  g_mutex_unlock (&watchdog.lock);
+
+  g_thread_join (g_steal_pointer (&watchdog.thread));
+  g_main_context_set_poll_func (NULL, watchdog.poll_func);
+}
+
+PpdWatchdogScope
+ppd_watchdog_enter (const char *kind,
+                    const char *name)
+{
+  g_mutex_lock (&watchdog.lock);
+  /* Nested dispatches are part of the outer one */
+  if (watchdog.depth++ == 0)
+    g_snprintf (watchdog.dispatch, DISPATCH_SIZE, "%s %s", kind, name);
+  g_mutex_unlock (&watchdog.lock);
+
+  return TRUE;
+}
+
+void
+ppd_watchdog_leave (PpdWatchdogScope scope)
+{
+  g_mutex_lock (&watchdog.lock);
+  g_warn_if_fail (watchdog.depth > 0);
+  /* The name is kept, in case the rest of the iteration stalls */
+  watchdog.depth--;
+  g_mutex_unlock (&watchdog.lock);
+}
+
+GVariant *
+ppd_watchdog_get_variant (void)
+{
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&watchdog.lock);
+  GVariantBuilder builder;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+  for (guint i = 0; i < watchdog.n_worst; i++) {
+    GVariantBuilder stall_builder;
+
+    g_variant_builder_init (&stall_builder, G_VARIANT_TYPE ("a{sv}"));
+    g_variant_builder_add (&stall_builder, "{sv}", "Dispatch",
+                           g_variant_new_string (watchdog.worst[i].dispatch));
+    g_variant_builder_add (&stall_builder, "{sv}", "Duration",
+                           g_variant_new_uint64 (watchdog.worst[i].duration));
+    g_variant_builder_add (&stall_builder, "{sv}", "Time",
+                           g_variant_new_int64 (watchdog.worst[i].time));
+    g_variant_builder_add (&builder, "a{sv}", &stall_builder);
+  }
+
+  return g_variant_builder_end (&builder);
+}
+
+static gboolean
+watched_source_dispatch (gpointer user_data)
+{
+  WatchedSource *source = user_data;
+  g_auto(PpdWatchdogScope) scope = ppd_watchdog_enter ("source", source->name);
+
+  return source->func (source->user_data);
+}
+
+static WatchedSource *
+watched_source_new (const char  *name,
+                    GSourceFunc  func,
+                    gpointer     user_data)
+{
+  WatchedSource *source = g_new (WatchedSource, 1);
+
+  source->name = name;
+  source->func = func;
+  source->user_data = user_data;
+
+  return source;
+}
+
+/* Like g_timeout_add(), @name must be a static string */
+guint
+ppd_watchdog_timeout_add (guint        interval,
+                          const char  *name,
+                          GSourceFunc  func,
+                          gpointer     user_data)
+{
+  guint id;
+
+  id = g_timeout_add_full (G_PRIORITY_DEFAULT, interval, watched_source_dispatch,
+                           watched_source_new (name, func, user_data), g_free);
+  g_source_set_name_by_id (id, name);
+
+  return id;
+}
+
+guint
+ppd_watchdog_timeout_add_seconds (guint        interval,
+                                  const char  *name,
+                                  GSourceFunc  func,
+                                  gpointer     user_data)
+{
+  guint id;
+
+  id = g_timeout_add_seconds_full (G_PRIORITY_DEFAULT, interval, watched_source_dispatch,
+                                   watched_source_new (name, func, user_data), g_free);
+  g_source_set_name_by_id (id, name);
+
+  return id;
+}
+
+guint
+ppd_watchdog_unix_signal_add (gint         signum,
+                              const char  *name,
+                              GSourceFunc  func,
+                              gpointer     user_data)
+{
+  guint id;
+
+  id = g_unix_signal_add_full (G_PRIORITY_DEFAULT, signum, watched_source_dispatch,
+                               watched_source_new (name, func, user_data), g_free);
+  g_source_set_name_by_id (id, name);
+
+  return id;
+}
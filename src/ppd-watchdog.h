@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2026 The power-profiles-daemon authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#pragma once
+
+#include <glib.h>
+
+/* Marks the main loop dispatch that is running, so that the stalls it
+ * causes can be attributed to it. Use as:
+ *
+ *   g_auto(PpdWatchdogScope) scope = ppd_watchdog_enter ("kind", name);
+ */
+typedef gboolean PpdWatchdogScope;
+
+gboolean ppd_watchdog_start (gint64   threshold,
+                             GError **error);
+void ppd_watchdog_stop (void);
+PpdWatchdogScope ppd_watchdog_enter (const char *kind,
+                                     const char *name);
+void ppd_watchdog_leave (PpdWatchdogScope scope);
+GVariant *ppd_watchdog_get_variant (void);
+guint ppd_watchdog_timeout_add (guint        interval,
+                                const char  *name,
+                                GSourceFunc  func,
+                                gpointer     user_data);
+guint ppd_watchdog_timeout_add_seconds (guint        interval,
+                                        const char  *name,
+                                        GSourceFunc  func,
+                                        gpointer     user_data);
+guint ppd_watchdog_unix_signal_add (gint         signum,
+                                    const char  *name,
+                                    GSourceFunc  func,
+                                    gpointer     user_data);
+
+G_DEFINE_AUTO_CLEANUP_FREE_FUNC (PpdWatchdogScope, ppd_watchdog_leave, FALSE)
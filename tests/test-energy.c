@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2026 The power-profiles-daemon authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#include <glib/gstdio.h>
+
+#include "ppd-energy.h"
+
+/* A package zone that wraps at 10000 uJ, and one that does not say */
+#define WRAPPING_ZONE "intel-rapl:0"
+#define OTHER_ZONE "intel-rapl:1"
+
+typedef struct {
+  char *root;
+  char *wrapping_counter;
+  char *other_counter;
+} Fixture;
+
+static char *
+add_zone (Fixture    *fixture,
+          const char *zone,
+          const char *name,
+          const char *max_range)
+{
+  g_autofree char *dir = g_build_filename (fixture->root, "sys/class/powercap", zone, NULL);
+  g_autofree char *name_path = g_build_filename (dir, "name", NULL);
+
+  g_assert_cmpint (g_mkdir_with_parents (dir, 0755), ==, 0);
+  g_assert_true (g_file_set_contents (name_path, name, -1, NULL));
+  if (max_range != NULL) {
+    g_autofree char *max_range_path = g_build_filename (dir, "max_energy_range_uj", NULL);
+
+    g_assert_true (g_file_set_contents (max_range_path, max_range, -1, NULL));
+  }
+
+  return g_build_filename (dir, "energy_uj", NULL);
+}
+
+static void
+set_counters (Fixture *fixture,
+              guint64  wrapping,
+              guint64  other)
+{
+  g_autofree char *wrapping_str = g_strdup_printf ("%" G_GUINT64_FORMAT "\n", wrapping);
+  g_autofree char *other_str = g_strdup_printf ("%" G_GUINT64_FORMAT "\n", other);
+
+  g_assert_true (g_file_set_contents (fixture->wrapping_counter, wrapping_str, -1, NULL));
+  g_assert_true (g_file_set_contents (fixture->other_counter, other_str, -1, NULL));
+
+  /* Durations of 0 leave the profile out of the results */
+  g_usleep (1000);
+}
+
+static void
+fixture_set_up (Fixture       *fixture,
+                gconstpointer  user_data)
+{
+  g_autofree char *control_type = NULL;
+
+  fixture->root = g_dir_make_tmp ("ppd-test-energy-XXXXXX", NULL);
+  g_assert_nonnull (fixture->root);
+  g_setenv ("UMOCKDEV_DIR", fixture->root, TRUE);
+
+  fixture->wrapping_counter = add_zone (fixture, WRAPPING_ZONE, "package-0", "10000");
+  fixture->other_counter = add_zone (fixture, OTHER_ZONE, "psys", NULL);
+
+  /* The control type is not a zone, and must be skipped */
+  control_type = g_build_filename (fixture->root, "sys/class/powercap/intel-rapl", NULL);
+  g_assert_cmpint (g_mkdir_with_parents (control_type, 0755), ==, 0);
+
+  set_counters (fixture, 1000, 500);
+}
+
+static void
+remove_tree (const char *path)
+{
+  g_autoptr(GDir) dir = g_dir_open (path, 0, NULL);
+  const char *entry;
+
+  while (dir != NULL && (entry = g_dir_read_name (dir)) != NULL) {
+    g_autofree char *child = g_build_filename (path, entry, NULL);
+
+    if (g_file_test (child, G_FILE_TEST_IS_DIR))
+      remove_tree (child);
+    else
+      g_unlink (child);
+  }
+  g_rmdir (path);
+}
+
+static void
+fixture_tear_down (Fixture       *fixture,
+                   gconstpointer  user_data)
+{
+  remove_tree (fixture->root);
+  g_unsetenv ("UMOCKDEV_DIR");
+  g_clear_pointer (&fixture->root, g_free);
+  g_clear_pointer (&fixture->wrapping_counter, g_free);
+  g_clear_pointer (&fixture->other_counter, g_free);
+}
+
+/* The energy used by @zone in @profile, or -1 if it is not listed */
+static gint64
+get_energy (GVariant   *energy,
+            const char *zone,
+            PpdProfile  profile)
+{
+  g_autoptr(GVariant) domains = NULL;
+  GVariantIter iter;
+  GVariant *domain;
+
+  domains = g_variant_lookup_value (energy, "Domains", G_VARIANT_TYPE ("aa{sv}"));
+  g_assert_nonnull (domains);
+
+  g_variant_iter_init (&iter, domains);
+  while ((domain = g_variant_iter_next_value (&iter)) != NULL) {
+    g_autoptr(GVariant) owned = domain;
+    g_autoptr(GVariant) per_profile = NULL;
+    const char *id;
+    guint64 value;
+
+    g_assert_true (g_variant_lookup (domain, "Id", "&s", &id));
+    if (g_strcmp0 (id, zone) != 0)
+      continue;
+
+    per_profile = g_variant_lookup_value (domain, "Energy", G_VARIANT_TYPE ("a{st}"));
+    if (!g_variant_lookup (per_profile, ppd_profile_to_str (profile), "t", &value))
+      return -1;
+    return value;
+  }
+
+  g_assert_not_reached ();
+  return -1;
+}
+
+static void
+test_domains (Fixture       *fixture,
+              gconstpointer  user_data)
+{
+  g_autoptr(PpdEnergy) energy = ppd_energy_new ();
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GVariant) domains = NULL;
+  g_autoptr(GVariant) first = NULL;
+  const char *name;
+
+  g_assert_cmpuint (ppd_energy_get_n_domains (energy), ==, 2);
+
+  variant = ppd_energy_get_variant (energy);
+  domains = g_variant_lookup_value (variant, "Domains", G_VARIANT_TYPE ("aa{sv}"));
+  g_assert_cmpuint (g_variant_n_children (domains), ==, 2);
+  /* Sorted by ID */
+  first = g_variant_get_child_value (domains, 0);
+  g_assert_true (g_variant_lookup (first, "Name", "&s", &name));
+  g_assert_cmpstr (name, ==, "package-0");
+}
+
+static void
+test_per_profile (Fixture       *fixture,
+                  gconstpointer  user_data)
+{
+  g_autoptr(PpdEnergy) energy = ppd_energy_new ();
+  g_autoptr(GVariant) variant = NULL;
+
+  /* Nothing was running before a profile was set */
+  set_counters (fixture, 1200, 600);
+  ppd_energy_set_profile (energy, PPD_PROFILE_BALANCED);
+
+  set_counters (fixture, 3200, 900);
+  ppd_energy_set_profile (energy, PPD_PROFILE_PERFORMANCE);
+
+  set_counters (fixture, 4000, 1000);
+  /* Setting the same profile again does not split anything */
+  ppd_energy_set_profile (energy, PPD_PROFILE_PERFORMANCE);
+  set_counters (fixture, 4500, 1100);
+
+  variant = ppd_energy_get_variant (energy);
+  g_assert_cmpint (get_energy (variant, WRAPPING_ZONE, PPD_PROFILE_BALANCED), ==, 2000);
+  g_assert_cmpint (get_energy (variant, OTHER_ZONE, PPD_PROFILE_BALANCED), ==, 300);
+  g_assert_cmpint (get_energy (variant, WRAPPING_ZONE, PPD_PROFILE_PERFORMANCE), ==, 1300);
+  g_assert_cmpint (get_energy (variant, OTHER_ZONE, PPD_PROFILE_PERFORMANCE), ==, 200);
+  g_assert_cmpint (get_energy (variant, WRAPPING_ZONE, PPD_PROFILE_POWER_SAVER), ==, -1);
+}
+
+static void
+test_wrap (Fixture       *fixture,
+           gconstpointer  user_data)
+{
+  g_autoptr(PpdEnergy) energy = ppd_energy_new ();
+  g_autoptr(GVariant) variant = NULL;
+
+  ppd_energy_set_profile (energy, PPD_PROFILE_BALANCED);
+
+  /* The zone with a known range wrapped, the other one went backwards,
+   * which cannot be accounted for */
+  set_counters (fixture, 500, 100);
+  ppd_energy_sample (energy);
+  /* Both count from the new readings afterwards */
+  set_counters (fixture, 800, 400);
+
+  variant = ppd_energy_get_variant (energy);
+  g_assert_cmpint (get_energy (variant, WRAPPING_ZONE, PPD_PROFILE_BALANCED), ==,
+                   10000 - 1000 + 500 + 300);
+  g_assert_cmpint (get_energy (variant, OTHER_ZONE, PPD_PROFILE_BALANCED), ==, 300);
+}
+
+static void
+test_sleep (Fixture       *fixture,
+            gconstpointer  user_data)
+{
+  g_autoptr(PpdEnergy) energy = ppd_energy_new ();
+  g_autoptr(GVariant) variant = NULL;
+
+  ppd_energy_set_profile (energy, PPD_PROFILE_POWER_SAVER);
+
+  set_counters (fixture, 1700, 650);
+  ppd_energy_prepare_to_sleep (energy, TRUE);
+
+  /* The counters were reset while suspended, this is not a wrap */
+  set_counters (fixture, 100, 20);
+  ppd_energy_prepare_to_sleep (energy, FALSE);
+
+  set_counters (fixture, 400, 70);
+
+  variant = ppd_energy_get_variant (energy);
+  g_assert_cmpint (get_energy (variant, WRAPPING_ZONE, PPD_PROFILE_POWER_SAVER), ==, 700 + 300);
+  g_assert_cmpint (get_energy (variant, OTHER_ZONE, PPD_PROFILE_POWER_SAVER), ==, 150 + 50);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add ("/energy/domains", Fixture, NULL, fixture_set_up, test_domains, fixture_tear_down);
+  g_test_add ("/energy/per-profile", Fixture, NULL, fixture_set_up, test_per_profile, fixture_tear_down);
+  g_test_add ("/energy/wrap", Fixture, NULL, fixture_set_up, test_wrap, fixture_tear_down);
+  g_test_add ("/energy/sleep", Fixture, NULL, fixture_set_up, test_sleep, fixture_tear_down);
+
+  return g_test_run ();
+}
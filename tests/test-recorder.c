@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2026 The power-profiles-daemon authors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 3 as published by
+ * the Free Software Foundation.
+ *
+ */
+
+#include <string.h>
+
+#include "ppd-recorder.h"
+
+/* The last event, as returned over D-Bus */
+static GVariant *
+get_last_event (void)
+{
+  g_autoptr(GVariant) events = ppd_recorder_get_variant ();
+  gsize n_events = g_variant_n_children (events);
+
+  g_assert_cmpuint (n_events, >, 0);
+  return g_variant_get_child_value (events, n_events - 1);
+}
+
+static void
+test_truncate_utf8 (void)
+{
+  g_autoptr(GString) application_id = g_string_new ("org.example.");
+  g_autoptr(GString) reason = g_string_new (NULL);
+  g_autoptr(GVariant) event = NULL;
+  const char *subject;
+  const char *detail;
+
+  /* Two and three bytes long characters, which do not end where the
+   * subject and detail are cut */
+  for (guint i = 0; i < 40; i++)
+    g_string_append (application_id, "é");
+  for (guint i = 0; i < 50; i++)
+    g_string_append (reason, "€");
+
+  ppd_recorder_record (PPD_EVENT_HOLD, application_id->str, PPD_PROFILE_PERFORMANCE,
+                       1, 0, reason->str);
+
+  event = get_last_event ();
+  g_assert_true (g_variant_lookup (event, "Subject", "&s", &subject));
+  g_assert_true (g_variant_lookup (event, "Detail", "&s", &detail));
+
+  g_assert_true (g_utf8_validate (subject, -1, NULL));
+  g_assert_true (g_str_has_prefix (application_id->str, subject));
+  g_assert_cmpuint (strlen (subject), ==, strlen ("org.example.") + 17 * strlen ("é"));
+
+  g_assert_true (g_utf8_validate (detail, -1, NULL));
+  g_assert_true (g_str_has_prefix (reason->str, detail));
+  g_assert_cmpuint (strlen (detail), ==, 31 * strlen ("€"));
+}
+
+static void
+test_truncate_utf8_boundary (void)
+{
+  g_autoptr(GString) application_id = g_string_new ("org.example.A");
+  g_autoptr(GVariant) event = NULL;
+  const char *subject;
+
+  /* The last character that fits ends right where the subject is cut,
+   * so nothing has to be dropped */
+  for (guint i = 0; i < 40; i++)
+    g_string_append (application_id, "é");
+
+  ppd_recorder_record (PPD_EVENT_HOLD, application_id->str, PPD_PROFILE_PERFORMANCE,
+                       1, 0, NULL);
+
+  event = get_last_event ();
+  g_assert_true (g_variant_lookup (event, "Subject", "&s", &subject));
+  g_assert_true (g_utf8_validate (subject, -1, NULL));
+  g_assert_cmpuint (strlen (subject), ==, strlen ("org.example.A") + 17 * strlen ("é"));
+}
+
+static void
+test_invalid_utf8 (void)
+{
+  g_autoptr(GVariant) event = NULL;
+  const char *subject;
+
+  /* Program names come from the file system, in any encoding */
+  ppd_recorder_record (PPD_EVENT_SPAWN, "/usr/bin/caf\xe9", PPD_PROFILE_UNSET, 0, 0, NULL);
+
+  event = get_last_event ();
+  g_assert_true (g_variant_lookup (event, "Subject", "&s", &subject));
+  g_assert_true (g_utf8_validate (subject, -1, NULL));
+  g_assert_true (g_str_has_prefix (subject, "/usr/bin/caf"));
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/recorder/truncate-utf8", test_truncate_utf8);
+  g_test_add_func ("/recorder/truncate-utf8-boundary", test_truncate_utf8_boundary);
+  g_test_add_func ("/recorder/invalid-utf8", test_invalid_utf8);
+
+  return g_test_run ();
+}